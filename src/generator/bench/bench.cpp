@@ -4,6 +4,13 @@
 
 #include <range/v3/all.hpp>
 
+#include <climits>
+#include <stdexcept>
+#include <vector>
+#ifdef HAS_STD_RANGES
+#include <ranges>
+#endif
+
 template <class Generator>
 Generator co_ints(int start, int end) {
   for (int i = start; i < end; ++i) {
@@ -58,6 +65,22 @@ void bench_ints_ranges(int n) {
   }
 }
 
+#ifdef HAS_STD_RANGES
+// An unbounded generator cut short by std::views::take, iterated with a plain range-for
+// over the generator's own iterator and sentinel.
+void bench_ints_generator_toby_std(int n) {
+  for (int i : co_ints<toby::generator<int>>(0, INT_MAX) | std::views::take(n)) {
+    consume(i);
+  }
+}
+
+void bench_ints_std_ranges(int n) {
+  for (int i : std::views::iota(0, n)) {
+    consume(i);
+  }
+}
+#endif
+
 template <typename Generator, typename InputRange, typename UnaryPredicate>
 auto co_remove_if_impl(InputRange range, UnaryPredicate pred) -> Generator {
   RANGES_FOR(auto&& x, range) {
@@ -145,3 +168,209 @@ void bench_filter_ranges(int n) {
     consume(i);
   }
 }
+
+#ifdef HAS_STD_RANGES
+void bench_filter_generator_toby_std(int n) {
+  for (int i : co_ints<toby::generator<int>>(0, n) | std::views::filter(pred)) {
+    consume(i);
+  }
+}
+
+void bench_filter_std_ranges(int n) {
+  for (int i : std::views::iota(0, n) | std::views::filter(pred)) {
+    consume(i);
+  }
+}
+#endif
+
+// Heavy elements: expensive to default-construct and to assign, like a record owning a
+// buffer. gor::generator default-constructs one and copy-assigns every element into it;
+// toby::generator constructs each element in the promise.
+
+struct heavy {
+  heavy() : values(64) {}
+  explicit heavy(int i) : values(64, i) {}
+  std::vector<int> values;
+};
+
+template <class Generator>
+Generator co_heavy(int start, int end) {
+  for (int i = start; i < end; ++i) {
+    co_yield heavy(i);
+  }
+}
+
+toby::generator<heavy> co_heavy_emplace(int start, int end) {
+  for (int i = start; i < end; ++i) {
+    co_yield toby::emplace(i);
+  }
+}
+
+void bench_heavy_generator_toby(int n) {
+  RANGES_FOR(const heavy& h, co_heavy<toby::generator<heavy>>(0, n)) {
+    consume(h.values[0]);
+  }
+}
+
+void bench_heavy_generator_toby_emplace(int n) {
+  RANGES_FOR(const heavy& h, co_heavy_emplace(0, n)) { consume(h.values[0]); }
+}
+
+void bench_heavy_generator_gor(int n) {
+  for (const heavy& h : co_heavy<gor::generator<heavy>>(0, n)) {
+    consume(h.values[0]);
+  }
+}
+
+void bench_heavy_handrolled(int n) {
+  for (int i = 0; i < n; ++i) {
+    heavy h(i);
+    consume(h.values[0]);
+  }
+}
+
+// Emitting a pre-built buffer: one co_yield per element, or all of them at once with
+// toby::elements_of.
+
+static const std::vector<int>& buffer_of(int n) {
+  static std::vector<int> buffer;
+  if (buffer.size() != static_cast<std::size_t>(n)) {
+    buffer.resize(n);
+    for (int i = 0; i < n; ++i) buffer[i] = i;
+  }
+  return buffer;
+}
+
+template <class Generator>
+Generator co_buffer_loop(const std::vector<int>& buffer) {
+  for (int x : buffer) {
+    co_yield x;
+  }
+}
+
+toby::generator<int> co_buffer_elements_of(std::vector<int> buffer) {
+  co_yield toby::elements_of(buffer);
+}
+
+void bench_buffer_generator_toby(int n) {
+  RANGES_FOR(int i, co_buffer_loop<toby::generator<int>>(buffer_of(n))) { consume(i); }
+}
+
+void bench_buffer_generator_toby_elements_of(int n) {
+  RANGES_FOR(int i, co_buffer_elements_of(buffer_of(n))) { consume(i); }
+}
+
+void bench_buffer_generator_gor(int n) {
+  for (int i : co_buffer_loop<gor::generator<int>>(buffer_of(n))) {
+    consume(i);
+  }
+}
+
+void bench_buffer_handrolled(int n) {
+  for (int i : buffer_of(n)) {
+    consume(i);
+  }
+}
+
+// Deep pipelines: the same stage stacked `depth` times on top of co_ints, to see how
+// the per-element cost of nested resume() calls grows with the number of stages.
+
+template <typename Generator, typename InputRange>
+auto co_pass_impl(InputRange range) -> Generator {
+  RANGES_FOR(auto&& x, range) { co_yield x; }
+}
+
+template <typename Generator, typename InputRange>
+auto co_pass_nonrange_impl(InputRange range) -> Generator {
+  for (auto&& x : range) {
+    co_yield x;
+  }
+}
+
+auto identity = [](int x) { return x; };
+
+toby::generator<int> deep_pass_toby(int n, int depth) {
+  if (depth == 0) return co_ints<toby::generator<int>>(0, n);
+  return co_pass_impl<toby::generator<int>>(deep_pass_toby(n, depth - 1));
+}
+
+toby::generator<int> deep_filter_toby(int n, int depth) {
+  if (depth == 0) return co_ints<toby::generator<int>>(0, n);
+  return co_remove_if_impl<toby::generator<int>>(deep_filter_toby(n, depth - 1), pred);
+}
+
+gor::generator<int> deep_pass_gor(int n, int depth) {
+  if (depth == 0) return co_ints<gor::generator<int>>(0, n);
+  return co_pass_nonrange_impl<gor::generator<int>>(deep_pass_gor(n, depth - 1));
+}
+
+gor::generator<int> deep_filter_gor(int n, int depth) {
+  if (depth == 0) return co_ints<gor::generator<int>>(0, n);
+  return co_remove_if_nonrange_impl<gor::generator<int>>(deep_filter_gor(n, depth - 1),
+                                                         pred);
+}
+
+// Views have a different type at every depth, so the stack is built at compile time.
+template <int Depth>
+struct view_stack {
+  template <typename Rng, typename Stage>
+  static auto apply(Rng rng, Stage stage) {
+    return view_stack<Depth - 1>::apply(std::move(rng) | stage, stage);
+  }
+};
+
+template <>
+struct view_stack<0> {
+  template <typename Rng, typename Stage>
+  static Rng apply(Rng rng, Stage) {
+    return rng;
+  }
+};
+
+template <int Depth, typename Stage>
+void run_deep_ranges(int n, Stage stage) {
+  RANGES_FOR(int i, view_stack<Depth>::apply(ranges::view::ints(0, n), stage)) {
+    consume(i);
+  }
+}
+
+template <typename Stage>
+void run_deep_ranges(int n, int depth, Stage stage) {
+  switch (depth) {
+    case 1: run_deep_ranges<1>(n, stage); break;
+    case 2: run_deep_ranges<2>(n, stage); break;
+    case 4: run_deep_ranges<4>(n, stage); break;
+    case 8: run_deep_ranges<8>(n, stage); break;
+    case 16: run_deep_ranges<16>(n, stage); break;
+    case 32: run_deep_ranges<32>(n, stage); break;
+    default: throw std::invalid_argument("unsupported view stack depth");
+  }
+}
+
+void bench_deep_pass_generator_toby(int n, int depth) {
+  RANGES_FOR(int i, deep_pass_toby(n, depth)) { consume(i); }
+}
+
+void bench_deep_pass_generator_gor(int n, int depth) {
+  for (int i : deep_pass_gor(n, depth)) {
+    consume(i);
+  }
+}
+
+void bench_deep_pass_ranges(int n, int depth) {
+  run_deep_ranges(n, depth, ranges::view::transform(identity));
+}
+
+void bench_deep_filter_generator_toby(int n, int depth) {
+  RANGES_FOR(int i, deep_filter_toby(n, depth)) { consume(i); }
+}
+
+void bench_deep_filter_generator_gor(int n, int depth) {
+  for (int i : deep_filter_gor(n, depth)) {
+    consume(i);
+  }
+}
+
+void bench_deep_filter_ranges(int n, int depth) {
+  run_deep_ranges(n, depth, ranges::view::remove_if(pred));
+}
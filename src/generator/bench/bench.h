@@ -1,6 +1,15 @@
 #ifndef BENCH_H
 #define BENCH_H
 
+#if defined(__has_include)
+#if __has_include(<version>)
+#include <version>
+#endif
+#endif
+#if defined(__cpp_lib_ranges) && !defined(HAS_STD_RANGES)
+#define HAS_STD_RANGES
+#endif
+
 void bench_ints_generator_toby(int n);
 void bench_ints_generator_gor(int n);
 #ifdef HAS_EXPERIMENTAL_GENERATOR
@@ -9,6 +18,10 @@ void bench_ints_generator_exp(int n);
 void bench_ints_generator_toby_atomic(int n);
 void bench_ints_handrolled(int n);
 void bench_ints_ranges(int n);
+#ifdef HAS_STD_RANGES
+void bench_ints_generator_toby_std(int n);
+void bench_ints_std_ranges(int n);
+#endif
 
 void bench_filter_generator_toby(int n);
 void bench_filter_generator_toby_ref(int n);
@@ -20,5 +33,28 @@ void bench_filter_generator_exp(int n);
 // void bench_filter_generator_toby_atomic(int n);
 void bench_filter_handrolled(int n);
 void bench_filter_ranges(int n);
+#ifdef HAS_STD_RANGES
+void bench_filter_generator_toby_std(int n);
+void bench_filter_std_ranges(int n);
+#endif
+
+void bench_heavy_generator_toby(int n);
+void bench_heavy_generator_toby_emplace(int n);
+void bench_heavy_generator_gor(int n);
+void bench_heavy_handrolled(int n);
+
+void bench_buffer_generator_toby(int n);
+void bench_buffer_generator_toby_elements_of(int n);
+void bench_buffer_generator_gor(int n);
+void bench_buffer_handrolled(int n);
+
+// Depths 1, 2, 4, 8, 16 and 32 are supported by every variant.
+void bench_deep_pass_generator_toby(int n, int depth);
+void bench_deep_pass_generator_gor(int n, int depth);
+void bench_deep_pass_ranges(int n, int depth);
+
+void bench_deep_filter_generator_toby(int n, int depth);
+void bench_deep_filter_generator_gor(int n, int depth);
+void bench_deep_filter_ranges(int n, int depth);
 
 #endif  // BENCH_H
@@ -0,0 +1,88 @@
+// Multithreaded create/copy/destroy throughput for toby::generator, comparing a plain
+// and an atomic RefCountType as the number of threads grows.
+//
+// Usage: generator_bench_contention [ops-per-thread]
+
+#include "generator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+template <class Generator>
+Generator co_ints(int start, int end) {
+  for (int i = start; i < end; ++i) {
+    co_yield i;
+  }
+}
+
+extern void consume(int);
+
+// Each thread creates its own generator, copies it and destroys both. The reference
+// count is never touched by more than one thread, so this is the uncontended cost of
+// the refcount type plus frame allocation.
+template <class Generator>
+void private_workload(int ops, const Generator&) {
+  for (int i = 0; i < ops; ++i) {
+    auto g    = co_ints<Generator>(0, 1);
+    auto copy = g;
+    for (int x : copy) consume(x);
+  }
+}
+
+// Every thread copies and destroys the same generator, so they all hammer one
+// reference count. Only meaningful (and only safe) with an atomic RefCountType.
+template <class Generator>
+void shared_workload(int ops, const Generator& shared) {
+  for (int i = 0; i < ops; ++i) {
+    Generator copy  = shared;
+    Generator again = copy;
+  }
+}
+
+template <class Generator, class Workload>
+double run(int threads, int ops, Workload workload) {
+  Generator shared = co_ints<Generator>(0, 1);
+  std::atomic<bool> go{false};
+  std::vector<std::thread> pool;
+  for (int t = 0; t < threads; ++t) {
+    pool.emplace_back([&] {
+      while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+      workload(ops, shared);
+    });
+  }
+  auto start = std::chrono::steady_clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto& th : pool) th.join();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return static_cast<double>(threads) * ops / elapsed.count();
+}
+
+template <class Generator, class Workload>
+void report(const char* name, int max_threads, int ops, Workload workload) {
+  double base = 0;
+  for (int threads = 1;; threads = std::min(threads * 2, max_threads)) {
+    double rate = run<Generator>(threads, ops, workload);
+    if (threads == 1) base = rate;
+    std::printf("%-24s %3d threads %12.0f ops/s  %5.2fx\n", name, threads, rate,
+                rate / base);
+    if (threads == max_threads) break;
+  }
+}
+
+int main(int argc, char** argv) {
+  int ops         = argc > 1 ? std::atoi(argv[1]) : 200000;
+  int max_threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+  using plain  = toby::generator<int>;
+  using atomic = toby::generator<int, std::atomic<int>>;
+
+  report<plain>("private/int", max_threads, ops, private_workload<plain>);
+  report<atomic>("private/atomic<int>", max_threads, ops, private_workload<atomic>);
+  report<atomic>("shared/atomic<int>", max_threads, ops, shared_workload<atomic>);
+  return 0;
+}
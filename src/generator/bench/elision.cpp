@@ -0,0 +1,105 @@
+// Heap allocation elision (HALO) of generator coroutine frames.
+//
+// A C++20 compiler may put a coroutine's frame on the caller's stack instead of the
+// heap when it can see that the frame never outlives the caller: the coroutine has to
+// be inlined into a caller that also visibly destroys it. Whether that happens depends
+// on the compiler, the optimisation level and the generator type, so this counts the
+// calls to global operator new made while each shape below runs and reports how many
+// of its frames were elided.
+//
+// Usage: generator_bench_elision [iterations]
+
+#include "generator.h"
+#include "gor_generator.h"
+
+#include <range/v3/all.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static std::size_t allocations = 0;
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+extern void consume(int);
+
+template <class Generator>
+Generator co_ints(int start, int end) {
+  for (int i = start; i < end; ++i) {
+    co_yield i;
+  }
+}
+
+template <class Generator, class InputRange>
+Generator co_evens(InputRange range) {
+  RANGES_FOR(auto&& x, range) {
+    if (x % 2 == 0) co_yield x;
+  }
+}
+
+// One frame, created and destroyed within the caller: the case HALO is meant for.
+static void local_ints_toby() {
+  RANGES_FOR(int i, co_ints<toby::generator<int>>(0, 100)) { consume(i); }
+}
+
+static void local_ints_gor() {
+  for (int i : co_ints<gor::generator<int>>(0, 100)) {
+    consume(i);
+  }
+}
+
+// Two frames, the inner one owned by the outer.
+static void local_filter_toby() {
+  using generator = toby::generator<int>;
+  RANGES_FOR(int i, co_evens<generator>(co_ints<generator>(0, 100))) { consume(i); }
+}
+
+static void local_filter_gor() {
+  for (int i : co_evens<gor::generator<int>>(co_ints<gor::generator<int>>(0, 100))) {
+    consume(i);
+  }
+}
+
+// The frame escapes through an opaque function, so it can never be elided; a check
+// that the counting works.
+#if defined(_MSC_VER)
+__declspec(noinline)
+#else
+__attribute__((noinline))
+#endif
+static toby::generator<int> escaping_ints() {
+  return co_ints<toby::generator<int>>(0, 100);
+}
+
+static void escaping_ints_toby() {
+  RANGES_FOR(int i, escaping_ints()) { consume(i); }
+}
+
+static void measure(const char* name, int frames, void (*run)(), int iterations) {
+  std::size_t before = allocations;
+  for (int i = 0; i < iterations; ++i) run();
+  double per_call = static_cast<double>(allocations - before) / iterations;
+  const char* verdict = per_call == 0 ? "elided" : per_call < frames ? "partly elided"
+                                                                      : "heap";
+  std::printf("%-20s %d frame(s)  %5.2f allocs/call  %s\n", name, frames, per_call,
+              verdict);
+}
+
+int main(int argc, char** argv) {
+  int iterations = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+  measure("local_ints_toby", 1, local_ints_toby, iterations);
+  measure("local_ints_gor", 1, local_ints_gor, iterations);
+  measure("local_filter_toby", 2, local_filter_toby, iterations);
+  measure("local_filter_gor", 2, local_filter_gor, iterations);
+  measure("escaping_ints_toby", 1, escaping_ints_toby, iterations);
+  return 0;
+}
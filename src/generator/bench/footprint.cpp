@@ -0,0 +1,111 @@
+// Memory footprint of many live, suspended toby::generators.
+//
+// For each generator shape this creates N generators, resumes each one once so that it
+// is parked at its first co_yield, and reports the bytes allocated per generator (via
+// a counting global operator new), the growth in resident set size and the time taken
+// to resume every generator once more.
+//
+// Usage: generator_bench_footprint [count]
+
+#include "generator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+static std::size_t allocated_bytes = 0;
+static std::size_t allocations     = 0;
+
+void* operator new(std::size_t size) {
+  allocated_bytes += size;
+  ++allocations;
+  if (void* p = std::malloc(size)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+static std::size_t resident_bytes() {
+#ifdef __linux__
+  long pages = 0, resident = 0;
+  if (FILE* f = std::fopen("/proc/self/statm", "r")) {
+    if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    std::fclose(f);
+  }
+  return static_cast<std::size_t>(resident) * sysconf(_SC_PAGESIZE);
+#else
+  return 0;
+#endif
+}
+
+toby::generator<int> ints(int n) {
+  for (int i = 0; i < n; ++i) co_yield i;
+}
+
+toby::generator<int> filtered(int n) {
+  for (int i : ints(n)) {
+    if (i % 2 == 0) co_yield i;
+  }
+}
+
+toby::generator<std::string> strings(int n) {
+  for (int i = 0; i < n; ++i) co_yield std::to_string(i);
+}
+
+toby::generator<int> big_local(int n) {
+  int buffer[64] = {};
+  for (int i = 0; i < n; ++i) {
+    buffer[i % 64] = i;
+    co_yield buffer[i % 64];
+  }
+}
+
+template <class Make>
+void measure(const char* name, std::size_t count, Make make) {
+  using generator = decltype(make());
+  using iterator  = decltype(make().begin());
+
+  // Sized up front so that only the generators show up in the measurements.
+  std::vector<generator> gens(count);
+  std::vector<iterator> its(count);
+
+  std::size_t rss_before    = resident_bytes();
+  std::size_t bytes_before  = allocated_bytes;
+  std::size_t allocs_before = allocations;
+  for (std::size_t i = 0; i < count; ++i) {
+    gens[i] = make();
+    its[i]  = gens[i].begin();
+  }
+  std::size_t bytes  = allocated_bytes - bytes_before;
+  std::size_t allocs = allocations - allocs_before;
+  std::size_t rss    = resident_bytes() - rss_before;
+
+  auto start = std::chrono::steady_clock::now();
+  for (auto& it : its) ++it;
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::printf("%-12s %9zu live  %7.1f bytes/gen  %5.2f allocs/gen  %8.1f MiB RSS  "
+              "%7.1f ns/resume\n",
+              name, count, static_cast<double>(bytes) / count,
+              static_cast<double>(allocs) / count, rss / (1024.0 * 1024.0),
+              elapsed.count() / count);
+}
+
+int main(int argc, char** argv) {
+  std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+  measure("ints", count, [] { return ints(1000); });
+  measure("filtered", count, [] { return filtered(1000); });
+  measure("strings", count, [] { return strings(1000); });
+  measure("big_local", count, [] { return big_local(1000); });
+  return 0;
+}
@@ -1,8 +1,10 @@
 #ifndef GOR_GENERATOR_H
 #define GOR_GENERATOR_H
 
+#include "generator.h"
+
 namespace gor {
-  namespace coro = std::experimental;
+  namespace coro = toby::coro;
   template <typename _Ty>
   struct generator {
     struct promise_type {
@@ -12,9 +14,10 @@ namespace gor {
         return {};
       }
       coro::suspend_always initial_suspend() { return {}; }
-      coro::suspend_always final_suspend() { return {}; }
+      coro::suspend_always final_suspend() noexcept { return {}; }
       generator get_return_object() { return generator{this}; }
       void return_void() {}
+      void unhandled_exception() { throw; }
     };
 
     struct iterator {
@@ -0,0 +1,114 @@
+// Throughput of one generator drained by 1 to 32 consumer threads: through a mutex
+// around its iterator, and through shared_generator taking single elements and batches.
+//
+// Usage: generator_bench_handout [elements] [batch-size]
+
+#include "generator.h"
+#include "shared_generator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+extern void consume(int);
+
+static int mix(int x, int rounds) {
+  auto h = static_cast<std::uint64_t>(x);
+  for (int i = 0; i < rounds; ++i) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+  }
+  return static_cast<int>(h & 0x7fffffff);
+}
+
+// The producer does some work for each element, and each consumer does more.
+static toby::generator<int> produce(int n) {
+  for (int i = 0; i < n; ++i) {
+    co_yield mix(i, 16);
+  }
+}
+
+static void work(int x) { consume(mix(x, 64)); }
+
+static void mutex_consumers(int n, int consumers, std::size_t) {
+  auto source = produce(n);
+  std::mutex mutex;
+  std::optional<decltype(source.begin())> current;
+  bool finished = false;
+  auto next     = [&]() -> std::optional<int> {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (finished) return std::nullopt;
+    if (current) {
+      ++*current;
+    } else {
+      current.emplace(source.begin());
+    }
+    finished = *current == source.end();
+    if (finished) return std::nullopt;
+    return **current;
+  };
+  std::vector<std::thread> threads;
+  for (int t = 0; t < consumers; ++t) {
+    threads.emplace_back([&] {
+      while (auto x = next()) work(*x);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+}
+
+static void shared_single(int n, int consumers, std::size_t) {
+  toby::shared_generator<int> shared(produce(n));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < consumers; ++t) {
+    threads.emplace_back([&] {
+      toby::shared_generator<int>::consumer consumer(shared);
+      while (auto x = consumer.next()) work(*x);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+}
+
+static void shared_batches(int n, int consumers, std::size_t batch_size) {
+  toby::shared_generator<int> shared(produce(n));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < consumers; ++t) {
+    threads.emplace_back([&] {
+      toby::shared_generator<int>::consumer consumer(shared);
+      std::vector<int> batch;
+      while (consumer.take(batch, batch_size) != 0) {
+        for (int x : batch) work(x);
+        batch.clear();
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+}
+
+using workload = void (*)(int, int, std::size_t);
+
+static void report(const char* name, workload run, int n, std::size_t batch_size) {
+  for (int consumers = 1; consumers <= 32; consumers *= 2) {
+    auto start = std::chrono::steady_clock::now();
+    run(n, consumers, batch_size);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-16s %3d consumers %12.0f elements/s\n", name, consumers,
+                n / elapsed.count());
+  }
+}
+
+int main(int argc, char** argv) {
+  int n           = argc > 1 ? std::atoi(argv[1]) : 2000000;
+  auto batch_size = static_cast<std::size_t>(argc > 2 ? std::atoi(argv[2]) : 64);
+
+  report("mutex", mutex_consumers, n, batch_size);
+  report("shared/single", shared_single, n, batch_size);
+  report("shared/batches", shared_batches, n, batch_size);
+  return 0;
+}
@@ -0,0 +1,95 @@
+// hash_join as the build side grows from fitting in cache to far outgrowing it: probe
+// rows joined per second in memory, against a join through std::unordered_multimap,
+// and with a memory budget of a quarter of the build side, so that both sides are
+// spilled and joined by grace hashing. Half the probe keys match one build row.
+//
+// Usage: generator_bench_hash_join [largest-build-rows] [probe-rows] [tmpdir]
+
+#include "generator.h"
+#include "hash_join.h"
+
+#include <range/v3/all.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <limits>
+#include <random>
+#include <unordered_map>
+
+struct row {
+  std::uint64_t key;
+  std::uint64_t payload;
+};
+
+static toby::generator<row> build_rows(std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) {
+    co_yield row{i * 2, i};
+  }
+}
+
+// Keys drawn from [0, 2 * keys), so that half are even and match a build row.
+static toby::generator<row> probe_rows(std::size_t n, std::size_t keys) {
+  std::mt19937_64 rng(42);
+  std::uniform_int_distribution<std::uint64_t> key(0, 2 * keys - 1);
+  for (std::size_t i = 0; i < n; ++i) {
+    co_yield row{key(rng), i};
+  }
+}
+
+static auto key_of = [](const row& r) { return r.key; };
+
+static double since(std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+static double unordered_multimap_join(std::size_t build, std::size_t probe,
+                                      std::uint64_t& checksum) {
+  auto start = std::chrono::steady_clock::now();
+  std::unordered_multimap<std::uint64_t, row> table;
+  RANGES_FOR(auto&& r, build_rows(build)) { table.emplace(r.key, r); }
+  RANGES_FOR(auto&& r, probe_rows(probe, build)) {
+    auto [first, last] = table.equal_range(r.key);
+    for (; first != last; ++first) checksum += first->second.payload ^ r.payload;
+  }
+  return since(start);
+}
+
+static double toby_hash_join(std::size_t build, std::size_t probe, std::size_t budget,
+                             const std::filesystem::path& tmpdir,
+                             std::uint64_t& checksum) {
+  auto start  = std::chrono::steady_clock::now();
+  auto joined = toby::hash_join(build_rows(build), probe_rows(probe, build), key_of,
+                                key_of, budget, tmpdir);
+  RANGES_FOR(auto&& m, joined) { checksum += m.first.payload ^ m.second.payload; }
+  return since(start);
+}
+
+int main(int argc, char** argv) {
+  std::size_t largest          = argc > 1 ? std::atoll(argv[1]) : 10000000;
+  std::size_t probe            = argc > 2 ? std::atoll(argv[2]) : 10000000;
+  std::filesystem::path tmpdir = argc > 3 ? argv[3] : "";
+
+  std::printf("%12s %18s %18s %18s\n", "build rows", "unordered_multimap",
+              "hash_join", "spilled hash_join");
+  bool agree = true;
+  for (std::size_t build = 1000; build <= largest; build *= 10) {
+    using table_type        = toby::detail::join_table<row, decltype(key_of)>;
+    auto unlimited          = std::numeric_limits<std::size_t>::max();
+    auto quarter            = table_type::footprint(build) / 4;
+    std::uint64_t expected  = 0;
+    std::uint64_t in_memory = 0;
+    std::uint64_t spilled   = 0;
+    double baseline         = unordered_multimap_join(build, probe, expected);
+    double table            = toby_hash_join(build, probe, unlimited, tmpdir, in_memory);
+    double spill            = toby_hash_join(build, probe, quarter, tmpdir, spilled);
+    std::printf("%12zu %16.0f/s %16.0f/s %16.0f/s\n", build, probe / baseline,
+                probe / table, probe / spill);
+    agree = agree && in_memory == expected && spilled == expected;
+  }
+  if (!agree) std::printf("the joins disagree!\n");
+  return !agree;
+}
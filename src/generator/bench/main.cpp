@@ -1,7 +1,11 @@
 #include "bench.h"
+#include "perf_counters.h"
 
 #include <hayai.hpp>
 
+#include <cstdio>
+#include <cstring>
+
 static const int NUM = 100;
 
 BENCHMARK(ints, generator_toby, 1000, 100000 / NUM) { bench_ints_generator_toby(NUM); }
@@ -21,6 +25,12 @@ BENCHMARK(ints, callback, 1000, 100000/NUM) {
 */
 
 BENCHMARK(ints, ranges, 1000, 100000 / NUM) { bench_ints_ranges(NUM); }
+#ifdef HAS_STD_RANGES
+BENCHMARK(ints, generator_toby_std, 1000, 100000 / NUM) {
+  bench_ints_generator_toby_std(NUM);
+}
+BENCHMARK(ints, std_ranges, 1000, 100000 / NUM) { bench_ints_std_ranges(NUM); }
+#endif
 
 BENCHMARK(filter, generator_toby, 1000, 100000 / NUM) {
   bench_filter_generator_toby(NUM);
@@ -37,11 +47,174 @@ BENCHMARK(filter, generator_exp, 1000, 100000 / NUM) { bench_filter_generator_ex
 #endif
 BENCHMARK(filter, handrolled, 1000, 100000 / NUM) { bench_filter_handrolled(NUM); }
 BENCHMARK(filter, ranges, 1000, 100000 / NUM) { bench_filter_ranges(NUM); }
+#ifdef HAS_STD_RANGES
+BENCHMARK(filter, generator_toby_std, 1000, 100000 / NUM) {
+  bench_filter_generator_toby_std(NUM);
+}
+BENCHMARK(filter, std_ranges, 1000, 100000 / NUM) { bench_filter_std_ranges(NUM); }
+#endif
+
+BENCHMARK(heavy, generator_toby, 1000, 100000 / NUM) { bench_heavy_generator_toby(NUM); }
+BENCHMARK(heavy, generator_toby_emplace, 1000, 100000 / NUM) {
+  bench_heavy_generator_toby_emplace(NUM);
+}
+BENCHMARK(heavy, generator_gor, 1000, 100000 / NUM) { bench_heavy_generator_gor(NUM); }
+BENCHMARK(heavy, handrolled, 1000, 100000 / NUM) { bench_heavy_handrolled(NUM); }
+
+BENCHMARK(buffer, generator_toby, 1000, 100000 / NUM) {
+  bench_buffer_generator_toby(NUM);
+}
+BENCHMARK(buffer, generator_toby_elements_of, 1000, 100000 / NUM) {
+  bench_buffer_generator_toby_elements_of(NUM);
+}
+BENCHMARK(buffer, generator_gor, 1000, 100000 / NUM) { bench_buffer_generator_gor(NUM); }
+BENCHMARK(buffer, handrolled, 1000, 100000 / NUM) { bench_buffer_handrolled(NUM); }
+
+BENCHMARK_P(deep_pass, generator_toby, 100, 10000 / NUM, (int depth)) {
+  bench_deep_pass_generator_toby(NUM, depth);
+}
+BENCHMARK_P_INSTANCE(deep_pass, generator_toby, (1));
+BENCHMARK_P_INSTANCE(deep_pass, generator_toby, (2));
+BENCHMARK_P_INSTANCE(deep_pass, generator_toby, (4));
+BENCHMARK_P_INSTANCE(deep_pass, generator_toby, (8));
+BENCHMARK_P_INSTANCE(deep_pass, generator_toby, (16));
+BENCHMARK_P_INSTANCE(deep_pass, generator_toby, (32));
+
+BENCHMARK_P(deep_pass, generator_gor, 100, 10000 / NUM, (int depth)) {
+  bench_deep_pass_generator_gor(NUM, depth);
+}
+BENCHMARK_P_INSTANCE(deep_pass, generator_gor, (1));
+BENCHMARK_P_INSTANCE(deep_pass, generator_gor, (2));
+BENCHMARK_P_INSTANCE(deep_pass, generator_gor, (4));
+BENCHMARK_P_INSTANCE(deep_pass, generator_gor, (8));
+BENCHMARK_P_INSTANCE(deep_pass, generator_gor, (16));
+BENCHMARK_P_INSTANCE(deep_pass, generator_gor, (32));
+
+BENCHMARK_P(deep_pass, ranges, 100, 10000 / NUM, (int depth)) {
+  bench_deep_pass_ranges(NUM, depth);
+}
+BENCHMARK_P_INSTANCE(deep_pass, ranges, (1));
+BENCHMARK_P_INSTANCE(deep_pass, ranges, (2));
+BENCHMARK_P_INSTANCE(deep_pass, ranges, (4));
+BENCHMARK_P_INSTANCE(deep_pass, ranges, (8));
+BENCHMARK_P_INSTANCE(deep_pass, ranges, (16));
+BENCHMARK_P_INSTANCE(deep_pass, ranges, (32));
+
+BENCHMARK_P(deep_filter, generator_toby, 100, 10000 / NUM, (int depth)) {
+  bench_deep_filter_generator_toby(NUM, depth);
+}
+BENCHMARK_P_INSTANCE(deep_filter, generator_toby, (1));
+BENCHMARK_P_INSTANCE(deep_filter, generator_toby, (2));
+BENCHMARK_P_INSTANCE(deep_filter, generator_toby, (4));
+BENCHMARK_P_INSTANCE(deep_filter, generator_toby, (8));
+BENCHMARK_P_INSTANCE(deep_filter, generator_toby, (16));
+BENCHMARK_P_INSTANCE(deep_filter, generator_toby, (32));
+
+BENCHMARK_P(deep_filter, generator_gor, 100, 10000 / NUM, (int depth)) {
+  bench_deep_filter_generator_gor(NUM, depth);
+}
+BENCHMARK_P_INSTANCE(deep_filter, generator_gor, (1));
+BENCHMARK_P_INSTANCE(deep_filter, generator_gor, (2));
+BENCHMARK_P_INSTANCE(deep_filter, generator_gor, (4));
+BENCHMARK_P_INSTANCE(deep_filter, generator_gor, (8));
+BENCHMARK_P_INSTANCE(deep_filter, generator_gor, (16));
+BENCHMARK_P_INSTANCE(deep_filter, generator_gor, (32));
+
+BENCHMARK_P(deep_filter, ranges, 100, 10000 / NUM, (int depth)) {
+  bench_deep_filter_ranges(NUM, depth);
+}
+BENCHMARK_P_INSTANCE(deep_filter, ranges, (1));
+BENCHMARK_P_INSTANCE(deep_filter, ranges, (2));
+BENCHMARK_P_INSTANCE(deep_filter, ranges, (4));
+BENCHMARK_P_INSTANCE(deep_filter, ranges, (8));
+BENCHMARK_P_INSTANCE(deep_filter, ranges, (16));
+BENCHMARK_P_INSTANCE(deep_filter, ranges, (32));
+
+struct perf_bench {
+  const char* fixture;
+  const char* name;
+  void (*fn)(int);
+};
+
+static const perf_bench perf_benches[] = {
+    {"ints", "generator_toby", bench_ints_generator_toby},
+    {"ints", "generator_gor", bench_ints_generator_gor},
+#ifdef HAS_EXPERIMENTAL_GENERATOR
+    {"ints", "generator_exp", bench_ints_generator_exp},
+#endif
+    {"ints", "generator_toby_atomic", bench_ints_generator_toby_atomic},
+    {"ints", "handrolled", bench_ints_handrolled},
+    {"ints", "ranges", bench_ints_ranges},
+#ifdef HAS_STD_RANGES
+    {"ints", "generator_toby_std", bench_ints_generator_toby_std},
+    {"ints", "std_ranges", bench_ints_std_ranges},
+#endif
+    {"filter", "generator_toby", bench_filter_generator_toby},
+    {"filter", "generator_toby_ref", bench_filter_generator_toby_ref},
+    {"filter", "generator_gor", bench_filter_generator_gor},
+    {"filter", "generator_gor_ref", bench_filter_generator_gor_ref},
+#ifdef HAS_EXPERIMENTAL_GENERATOR
+    {"filter", "generator_exp", bench_filter_generator_exp},
+#endif
+    {"filter", "handrolled", bench_filter_handrolled},
+    {"filter", "ranges", bench_filter_ranges},
+#ifdef HAS_STD_RANGES
+    {"filter", "generator_toby_std", bench_filter_generator_toby_std},
+    {"filter", "std_ranges", bench_filter_std_ranges},
+#endif
+    {"heavy", "generator_toby", bench_heavy_generator_toby},
+    {"heavy", "generator_toby_emplace", bench_heavy_generator_toby_emplace},
+    {"heavy", "generator_gor", bench_heavy_generator_gor},
+    {"heavy", "handrolled", bench_heavy_handrolled},
+    {"buffer", "generator_toby", bench_buffer_generator_toby},
+    {"buffer", "generator_toby_elements_of", bench_buffer_generator_toby_elements_of},
+    {"buffer", "generator_gor", bench_buffer_generator_gor},
+    {"buffer", "handrolled", bench_buffer_handrolled},
+};
+
+// Runs each benchmark under hardware performance counters and reports the counts per
+// input element, to separate e.g. indirect-branch cost from memory traffic.
+static void run_perf_counters() {
+  perf_counters counters;
+  if (!counters.available()) {
+    std::printf("[ PERF     ] hardware counters unavailable: %s\n",
+                counters.error().c_str());
+    return;
+  }
+  if (!counters.error().empty()) {
+    std::printf("[ PERF     ] some counters unavailable: %s\n", counters.error().c_str());
+  }
+
+  const int runs        = 1000;
+  const double elements = static_cast<double>(runs) * NUM;
+  for (const perf_bench& b : perf_benches) {
+    b.fn(NUM);  // warm up
+    counters.start();
+    for (int i = 0; i < runs; ++i) b.fn(NUM);
+    perf_counters::reading r = counters.stop();
+
+    std::printf("[ PERF     ] %s.%s:", b.fixture, b.name);
+    for (int e = 0; e < perf_counters::num_events; ++e) {
+      if (r.valid[e]) {
+        std::printf(" %.3f %s", r.values[e] / elements,
+                    perf_counters::name(static_cast<perf_counters::event>(e)));
+      }
+    }
+    std::printf(" per element\n");
+  }
+}
+
+int main(int argc, char** argv) {
+  bool perf = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--perf-counters") == 0) perf = true;
+  }
 
-int main() {
   hayai::ConsoleOutputter consoleOutputter;
 
   hayai::Benchmarker::AddOutputter(consoleOutputter);
   hayai::Benchmarker::RunAllTests();
+
+  if (perf) run_perf_counters();
   return 0;
 }
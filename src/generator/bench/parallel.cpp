@@ -0,0 +1,102 @@
+// Throughput of an expensive transform followed by a filter, run single-threaded as a
+// co_remove_if-style pipeline, with the ordered parallel_transform and with the
+// unordered, batched parallel_transform_filter, as the number of threads grows.
+//
+// Usage: generator_bench_parallel [elements] [batch-size]
+
+#include "generator.h"
+#include "parallel_transform.h"
+
+#include <range/v3/all.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+extern void consume(int);
+
+static toby::generator<int> co_ints(int start, int end) {
+  for (int i = start; i < end; ++i) {
+    co_yield i;
+  }
+}
+
+template <class InputRange, class UnaryPredicate>
+toby::generator<int> co_remove_if(InputRange range, UnaryPredicate pred) {
+  RANGES_FOR(auto&& x, range) {
+    if (pred(x)) co_yield x;
+  }
+}
+
+template <class InputRange, class Fn>
+toby::generator<int> co_transform(InputRange range, Fn fn) {
+  RANGES_FOR(auto&& x, range) { co_yield fn(x); }
+}
+
+// A few hundred nanoseconds of work per element, so there is something to parallelise.
+static int expensive_hash(int x) {
+  auto h = static_cast<std::uint64_t>(x);
+  for (int i = 0; i < 256; ++i) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+  }
+  return static_cast<int>(h & 0x7fffffff);
+}
+
+static bool keep(int x) { return x % 4 == 0; }
+
+static void serial(int n, unsigned, std::size_t) {
+  RANGES_FOR(int x, co_remove_if(co_transform(co_ints(0, n), expensive_hash), keep)) {
+    consume(x);
+  }
+}
+
+static void ordered(int n, unsigned threads, std::size_t batch) {
+  auto window = batch * 2 * threads;
+  RANGES_FOR(int x, co_remove_if(toby::parallel_transform(co_ints(0, n), expensive_hash,
+                                                          threads, window),
+                                 keep)) {
+    consume(x);
+  }
+}
+
+static void unordered(int n, unsigned threads, std::size_t batch) {
+  RANGES_FOR(int x, toby::parallel_transform_filter(co_ints(0, n), expensive_hash, keep,
+                                                    threads, batch)) {
+    consume(x);
+  }
+}
+
+using pipeline = void (*)(int, unsigned, std::size_t);
+
+static double run(pipeline p, int n, unsigned threads, std::size_t batch) {
+  auto start = std::chrono::steady_clock::now();
+  p(n, threads, batch);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return n / elapsed.count();
+}
+
+static void report(const char* name, pipeline p, unsigned max_threads, int n,
+                   std::size_t batch, double base) {
+  for (unsigned threads = 1;; threads = std::min(threads * 2, max_threads)) {
+    double rate = run(p, n, threads, batch);
+    std::printf("%-10s %3u threads %12.0f elements/s  %5.2fx\n", name, threads, rate,
+                rate / base);
+    if (threads == max_threads) break;
+  }
+}
+
+int main(int argc, char** argv) {
+  int n            = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  auto batch       = static_cast<std::size_t>(argc > 2 ? std::atoi(argv[2]) : 256);
+  auto max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  double base = run(serial, n, 1, batch);
+  std::printf("%-10s %3d threads %12.0f elements/s  %5.2fx\n", "serial", 1, base, 1.0);
+  report("ordered", ordered, max_threads, n, batch, base);
+  report("unordered", unordered, max_threads, n, batch, base);
+  return 0;
+}
@@ -0,0 +1,122 @@
+#include "perf_counters.h"
+
+#ifdef __linux__
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace {
+  perf_event_attr make_attr(perf_counters::event e) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    switch (e) {
+      case perf_counters::instructions:
+        attr.type   = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+      case perf_counters::cycles:
+        attr.type   = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+      case perf_counters::branch_misses:
+        attr.type   = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+      case perf_counters::l1d_misses:
+        attr.type   = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+      default: break;
+    }
+    return attr;
+  }
+}  // namespace
+
+perf_counters::perf_counters() {
+  for (int e = 0; e < num_events; ++e) {
+    perf_event_attr attr = make_attr(static_cast<event>(e));
+    m_fds[e] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    if (m_fds[e] < 0 && m_error.empty()) {
+      m_error = std::string(name(static_cast<event>(e))) + ": " + std::strerror(errno);
+      if (errno == EACCES || errno == EPERM) {
+        m_error += " (see /proc/sys/kernel/perf_event_paranoid)";
+      }
+    }
+  }
+}
+
+perf_counters::~perf_counters() {
+  for (int fd : m_fds) {
+    if (fd >= 0) close(fd);
+  }
+}
+
+bool perf_counters::available() const {
+  for (int fd : m_fds) {
+    if (fd >= 0) return true;
+  }
+  return false;
+}
+
+void perf_counters::start() {
+  for (int fd : m_fds) {
+    if (fd < 0) continue;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+perf_counters::reading perf_counters::stop() {
+  reading r;
+  for (int e = 0; e < num_events; ++e) {
+    if (m_fds[e] < 0) continue;
+    ioctl(m_fds[e], PERF_EVENT_IOC_DISABLE, 0);
+    // value, time_enabled, time_running
+    std::uint64_t buf[3];
+    if (read(m_fds[e], buf, sizeof(buf)) != sizeof(buf) || buf[2] == 0) continue;
+    // Scale up if the kernel had to multiplex this counter with others.
+    r.values[e] = buf[2] < buf[1]
+                      ? static_cast<std::uint64_t>(static_cast<double>(buf[0]) * buf[1] /
+                                                   buf[2])
+                      : buf[0];
+    r.valid[e] = true;
+  }
+  return r;
+}
+
+#else  // !__linux__
+
+perf_counters::perf_counters() : m_error("perf_event_open is only available on Linux") {
+  for (int& fd : m_fds) fd = -1;
+}
+
+perf_counters::~perf_counters() {}
+
+bool perf_counters::available() const { return false; }
+
+void perf_counters::start() {}
+
+perf_counters::reading perf_counters::stop() { return reading{}; }
+
+#endif
+
+const char* perf_counters::name(event e) {
+  switch (e) {
+    case instructions: return "instructions";
+    case cycles: return "cycles";
+    case branch_misses: return "branch-misses";
+    case l1d_misses: return "L1d-misses";
+    default: return "?";
+  }
+}
@@ -0,0 +1,40 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <string>
+
+// Hardware performance counters for the calling thread, read via perf_event_open.
+//
+// Each counter is opened independently so that a kernel or hypervisor that refuses
+// one event (L1d misses are commonly missing in VMs) doesn't take the others with it.
+// If none can be opened, `available()` is false and `error()` says why.
+class perf_counters {
+ public:
+  enum event { instructions, cycles, branch_misses, l1d_misses, num_events };
+
+  struct reading {
+    std::uint64_t values[num_events] = {};
+    bool valid[num_events]           = {};
+  };
+
+  perf_counters();
+  ~perf_counters();
+
+  perf_counters(const perf_counters&) = delete;
+  perf_counters& operator=(const perf_counters&) = delete;
+
+  bool available() const;
+  const std::string& error() const { return m_error; }
+
+  void start();
+  reading stop();
+
+  static const char* name(event e);
+
+ private:
+  int m_fds[num_events];
+  std::string m_error;
+};
+
+#endif  // PERF_COUNTERS_H
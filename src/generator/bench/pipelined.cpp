@@ -0,0 +1,88 @@
+// A four-stage pipeline (source, filter, transform, sink) run as a chain of generators
+// on one thread and with toby::pipelined, one thread per stage, with the per-stage
+// utilisation of the pipelined run.
+//
+// Usage: generator_bench_pipelined [elements] [batch-size]
+
+#include "generator.h"
+#include "pipelined.h"
+
+#include <range/v3/all.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+extern void consume(int);
+
+template <typename Generator>
+Generator co_ints(int start, int end) {
+  for (int i = start; i < end; ++i) {
+    co_yield i;
+  }
+}
+
+// The stage coroutines from bench.cpp, unchanged.
+template <typename Generator, typename InputRange, typename UnaryPredicate>
+auto co_remove_if_impl(InputRange range, UnaryPredicate pred) -> Generator {
+  RANGES_FOR(auto&& x, range) {
+    if (pred(x)) {
+      co_yield x;
+    }
+  }
+}
+
+template <typename Generator, typename InputRange, typename Fn>
+auto co_transform_impl(InputRange range, Fn fn) -> Generator {
+  RANGES_FOR(auto&& x, range) { co_yield fn(x); }
+}
+
+static int mix(int x, int rounds) {
+  auto h = static_cast<std::uint64_t>(x);
+  for (int i = 0; i < rounds; ++i) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+  }
+  return static_cast<int>(h & 0x7fffffff);
+}
+
+// Roughly balanced work for the filter and the transform.
+static bool keep(int x) { return mix(x, 64) % 2 == 0; }
+static int transform(int x) { return mix(x, 128); }
+
+using generator = toby::generator<int>;
+
+static auto filter_stage = [](auto in) {
+  return co_remove_if_impl<generator>(std::move(in), keep);
+};
+static auto transform_stage = [](auto in) {
+  return co_transform_impl<generator>(std::move(in), transform);
+};
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? std::atoi(argv[1]) : 10000000;
+  toby::pipeline_options options;
+  options.batch_size = argc > 2 ? std::atoi(argv[2]) : 256;
+  toby::pipeline_stats stats;
+  options.stats = &stats;
+
+  auto start = std::chrono::steady_clock::now();
+  RANGES_FOR(int x, transform_stage(filter_stage(co_ints<generator>(0, n)))) {
+    consume(x);
+  }
+  std::chrono::duration<double> serial = std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  RANGES_FOR(int x, toby::pipelined_with(options, co_ints<generator>(0, n), filter_stage,
+                                         transform_stage)) {
+    consume(x);
+  }
+  std::chrono::duration<double> pipelined = std::chrono::steady_clock::now() - start;
+
+  std::printf("serial    %8.3fs\npipelined %8.3fs  %5.2fx\n\n", serial.count(),
+              pipelined.count(), serial.count() / pipelined.count());
+  stats.dump_text(std::cout);
+  return 0;
+}
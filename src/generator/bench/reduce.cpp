@@ -0,0 +1,59 @@
+// Scaling of parallel_reduce: sums the ints in [0, n) from a splittable co_ints source
+// on a work_stealing_pool of 1, 2, 4, ... threads, against one generator summed on
+// one thread.
+//
+// Usage: generator_bench_reduce [elements] [grain]
+
+#include "generator.h"
+#include "parallel_reduce.h"
+
+#include <range/v3/all.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+static toby::generator<long long> co_ints(long long start, long long end) {
+  for (long long i = start; i < end; ++i) {
+    co_yield i;
+  }
+}
+
+template <class Sum>
+static double run(const char* name, unsigned threads, long long n, Sum sum) {
+  auto start       = std::chrono::steady_clock::now();
+  long long result = sum();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  if (result != n * (n - 1) / 2) {
+    std::fprintf(stderr, "%s on %u threads: wrong sum %lld\n", name, threads, result);
+    std::exit(1);
+  }
+  return n / elapsed.count();
+}
+
+int main(int argc, char** argv) {
+  long long n      = argc > 1 ? std::atoll(argv[1]) : 1000000000;
+  long long grain  = argc > 2 ? std::atoll(argv[2]) : 1 << 20;
+  auto max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  double base = run("serial", 1, n, [n] {
+    long long sum = 0;
+    RANGES_FOR(long long i, co_ints(0, n)) { sum += i; }
+    return sum;
+  });
+  std::printf("%-16s %3d threads %14.0f elements/s  %5.2fx\n", "serial", 1, base, 1.0);
+
+  auto source = toby::make_splittable(co_ints, 0ll, n, grain);
+  auto plus   = [](long long a, long long b) { return a + b; };
+  for (unsigned threads = 1;; threads = std::min(threads * 2, max_threads)) {
+    toby::work_stealing_pool pool(threads);
+    double rate = run("parallel_reduce", threads, n,
+                      [&] { return toby::parallel_reduce(pool, source, 0ll, plus); });
+    std::printf("%-16s %3u threads %14.0f elements/s  %5.2fx\n", "parallel_reduce",
+                threads, rate, rate / base);
+    if (threads == max_threads) break;
+  }
+  return 0;
+}
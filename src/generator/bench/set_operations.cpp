@@ -0,0 +1,87 @@
+// Intersecting sorted posting lists of ids, one `ratio` times sparser than the other:
+// ranges::view::set_intersection on generators, against toby::set_intersection on the
+// same generators, on generators that yield blocks of ids with elements_of, and on
+// spans. The ids intersected per second count both lists.
+//
+// Usage: generator_bench_set_operations [dense-ids] [block-size]
+
+#include "generator.h"
+#include "set_operations.h"
+
+#include <range/v3/all.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <span>
+#include <vector>
+
+extern void consume(int);
+
+/// About `n` distinct ids in order, drawn from [0, universe).
+static std::vector<std::uint32_t> posting_list(std::size_t n, std::uint32_t universe,
+                                               unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<std::uint32_t> id(0, universe - 1);
+  std::vector<std::uint32_t> ids(n);
+  for (auto& x : ids) x = id(rng);
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  return ids;
+}
+
+static toby::generator<std::uint32_t> one_by_one(const std::vector<std::uint32_t>& ids) {
+  for (auto id : ids) {
+    co_yield id;
+  }
+}
+
+static toby::generator<std::uint32_t> in_blocks(std::vector<std::uint32_t>& ids,
+                                                std::size_t block) {
+  for (std::size_t i = 0; i < ids.size(); i += block) {
+    co_yield toby::elements_of(
+        std::span<std::uint32_t>(ids.data() + i, std::min(block, ids.size() - i)));
+  }
+}
+
+template <class Intersect>
+static double rate(std::vector<std::uint32_t>& sparse, std::vector<std::uint32_t>& dense,
+                   Intersect intersect) {
+  auto start = std::chrono::steady_clock::now();
+  RANGES_FOR(auto id, intersect(sparse, dense)) { consume(static_cast<int>(id)); }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return (sparse.size() + dense.size()) / elapsed.count();
+}
+
+int main(int argc, char** argv) {
+  std::size_t n     = argc > 1 ? std::atoll(argv[1]) : 10000000;
+  std::size_t block = argc > 2 ? std::atoll(argv[2]) : 256;
+  auto universe     = static_cast<std::uint32_t>(4 * n);
+  auto dense        = posting_list(n, universe, 1);
+
+  std::printf("%8s %16s %16s %16s %16s\n", "ratio", "range-v3", "generators",
+              "blocks", "spans");
+  for (std::size_t ratio = 1; ratio <= 10000; ratio *= 10) {
+    auto sparse = posting_list(n / ratio, universe, 2);
+    using ids   = std::vector<std::uint32_t>&;
+    double r3   = rate(sparse, dense, [](ids a, ids b) {
+      return ranges::view::set_intersection(one_by_one(a), one_by_one(b));
+    });
+    double gens = rate(sparse, dense, [](ids a, ids b) {
+      return toby::set_intersection(one_by_one(a), one_by_one(b));
+    });
+    double blocks = rate(sparse, dense, [block](ids a, ids b) {
+      return toby::set_intersection(in_blocks(a, block), in_blocks(b, block));
+    });
+    double spans = rate(sparse, dense, [](ids a, ids b) {
+      return toby::set_intersection(std::span<const std::uint32_t>(a),
+                                    std::span<const std::uint32_t>(b));
+    });
+    std::printf("%6zu:1 %14.0f/s %14.0f/s %14.0f/s %14.0f/s\n", ratio, r3, gens, blocks,
+                spans);
+  }
+  return 0;
+}
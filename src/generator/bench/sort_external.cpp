@@ -0,0 +1,59 @@
+// sort_external on inputs several times its memory budget: the time to sort and
+// stream out random 64-bit keys, against std::sort of the same keys in memory.
+//
+// Usage: generator_bench_sort [budget-MiB] [input-multiple] [tmpdir]
+
+#include "generator.h"
+#include "sort_external.h"
+
+#include <range/v3/all.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+static toby::generator<std::uint64_t> random_keys(std::size_t n) {
+  std::mt19937_64 rng(42);
+  for (std::size_t i = 0; i < n; ++i) {
+    co_yield rng();
+  }
+}
+
+int main(int argc, char** argv) {
+  std::size_t budget_mib       = argc > 1 ? std::atoi(argv[1]) : 16;
+  std::size_t multiple         = argc > 2 ? std::atoi(argv[2]) : 10;
+  std::filesystem::path tmpdir = argc > 3 ? argv[3] : "";
+  std::size_t budget           = budget_mib << 20;
+  std::size_t n                = budget * multiple / sizeof(std::uint64_t);
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::uint64_t> keys;
+  RANGES_FOR(auto key, random_keys(n)) { keys.push_back(key); }
+  std::sort(keys.begin(), keys.end());
+  std::chrono::duration<double> in_memory = std::chrono::steady_clock::now() - start;
+  keys = std::vector<std::uint64_t>();
+
+  start                    = std::chrono::steady_clock::now();
+  std::uint64_t previous   = 0;
+  std::size_t out_of_order = 0;
+  auto sorted = toby::sort_external(random_keys(n), std::less<>(), budget, tmpdir);
+  RANGES_FOR(auto key, sorted) {
+    out_of_order += key < previous;
+    previous = key;
+  }
+  std::chrono::duration<double> external = std::chrono::steady_clock::now() - start;
+
+  std::printf("%zu keys, %zu MiB, budget %zu MiB\n", n, n * sizeof(std::uint64_t) >> 20,
+              budget >> 20);
+  std::printf("std::sort in memory %8.3fs %12.0f keys/s\n", in_memory.count(),
+              n / in_memory.count());
+  std::printf("sort_external       %8.3fs %12.0f keys/s\n", external.count(),
+              n / external.count());
+  if (out_of_order) std::printf("%zu keys out of order!\n", out_of_order);
+  return out_of_order != 0;
+}
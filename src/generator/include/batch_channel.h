@@ -0,0 +1,156 @@
+#pragma once
+
+#include "generator.h"
+#include "spsc_queue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace toby {
+  namespace detail {
+    /// Allocates whole cache lines, so that a batch doesn't share a line with anything
+    /// another thread writes.
+    template <class T>
+    struct cache_aligned_allocator {
+      using value_type = T;
+
+      cache_aligned_allocator() = default;
+      template <class U>
+      cache_aligned_allocator(const cache_aligned_allocator<U>&) {}
+
+      T* allocate(std::size_t n) {
+        return static_cast<T*>(
+            ::operator new(n * sizeof(T), std::align_val_t(alignment())));
+      }
+      void deallocate(T* p, std::size_t) {
+        ::operator delete(p, std::align_val_t(alignment()));
+      }
+
+      static constexpr std::size_t alignment() {
+        return std::max(cache_line, alignof(T));
+      }
+      template <class U>
+      bool operator==(const cache_aligned_allocator<U>&) const {
+        return true;
+      }
+      template <class U>
+      bool operator!=(const cache_aligned_allocator<U>&) const {
+        return false;
+      }
+    };
+
+    /// The smallest number of T, no fewer than `requested`, that fills a whole number
+    /// of cache lines.
+    template <class T>
+    std::size_t cache_line_batch(std::size_t requested) {
+      std::size_t bytes = std::max<std::size_t>(requested, 1) * sizeof(T);
+      bytes             = (bytes + cache_line - 1) / cache_line * cache_line;
+      return bytes / sizeof(T);
+    }
+  }  // namespace detail
+
+  /// Elements sent from one thread to another in batches over an spsc_queue, so that
+  /// the threads synchronise once per batch. Batches are cache-line aligned and hold
+  /// at least `batch_size` elements, rounded up to fill whole cache lines; at most
+  /// `depth` full batches wait in the queue, and a push that fills a batch waits for
+  /// room. Emptied batches are sent back to be reused.
+  ///
+  /// The time each side spends waiting for the other is recorded, for reporting where
+  /// a chain of threads is held up.
+  template <class T>
+  class batch_channel {
+    using clock = std::chrono::steady_clock;
+
+   public:
+    using batch = std::vector<T, detail::cache_aligned_allocator<T>>;
+
+    batch_channel(std::size_t batch_size, std::size_t depth)
+        : m_batch_size(detail::cache_line_batch<T>(batch_size)),
+          m_full(depth),
+          m_empty(depth + 2) {
+      m_filling.reserve(m_batch_size);
+    }
+
+    std::size_t batch_size() const { return m_batch_size; }
+
+    /// Producer: adds an element to the batch being filled and sends the batch once it
+    /// is full. Returns false if the channel has been cancelled, in which case the
+    /// batch is dropped.
+    template <class U>
+    bool push(U&& x) {
+      m_filling.push_back(std::forward<U>(x));
+      return m_filling.size() < m_batch_size || send();
+    }
+
+    /// Producer: sends what's left in the batch being filled; there'll be no more.
+    void close() {
+      if (!m_filling.empty()) send();
+      m_full.close();
+    }
+
+    /// Either side: makes the producer's pushes fail and ends the consumer's stream.
+    void cancel() { m_full.cancel(); }
+    bool cancelled() const { return m_full.cancelled(); }
+
+    /// Consumer: waits for the next full batch. Returns false once the channel is
+    /// closed and drained, or cancelled.
+    bool receive(batch& received) {
+      if (m_full.try_pop(received)) return true;
+      auto start  = clock::now();
+      bool popped = m_full.pop(received);
+      m_receive_wait += clock::now() - start;
+      return popped;
+    }
+
+    /// Consumer: hands a batch it has finished with back to the producer for reuse.
+    void recycle(batch& received) {
+      received.clear();
+      m_empty.try_push(std::move(received));
+    }
+
+    /// Consumer: the elements pushed, until the channel is closed or cancelled.
+    generator<T> stream() {
+      batch received;
+      while (receive(received)) {
+        co_yield elements_of(received);
+        recycle(received);
+      }
+    }
+
+    /// Seconds the producer has spent waiting for room.
+    double send_wait() const { return m_send_wait.count(); }
+    /// Seconds the consumer has spent waiting for a batch.
+    double receive_wait() const { return m_receive_wait.count(); }
+
+   private:
+    bool send() {
+      if (!m_full.try_push(std::move(m_filling))) {
+        auto start = clock::now();
+        bool sent  = m_full.push(std::move(m_filling));
+        m_send_wait += clock::now() - start;
+        if (!sent) {
+          m_filling.clear();
+          return false;
+        }
+      }
+      if (!m_empty.try_pop(m_filling)) {
+        m_filling = batch();
+        m_filling.reserve(m_batch_size);
+      }
+      return true;
+    }
+
+    const std::size_t m_batch_size;
+    spsc_queue<batch> m_full;
+    spsc_queue<batch> m_empty;
+    // Only used by the producer.
+    alignas(detail::cache_line) batch m_filling;
+    std::chrono::duration<double> m_send_wait{0};
+    // Only used by the consumer.
+    alignas(detail::cache_line) std::chrono::duration<double> m_receive_wait{0};
+  };
+}  // namespace toby
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+namespace toby {
+  /// Identifies the coroutine function that a frame belongs to, given the frame's
+  /// address (`coroutine_handle::address()`).
+  ///
+  /// Clang and GCC start every coroutine frame with pointers to the coroutine's resume
+  /// and destroy functions, and MSVC with a pointer to its resume function. Every frame
+  /// of the same coroutine shares those pointers and frames of different coroutines
+  /// don't, which makes them an identity that needs no registration from the
+  /// coroutine's author. Clang and GCC null the resume pointer once the coroutine is
+  /// done, so there the destroy pointer is used instead.
+  inline const void* coroutine_identity(const void* frame_address) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    return static_cast<const void* const*>(frame_address)[0];
+#else
+    return static_cast<const void* const*>(frame_address)[1];
+#endif
+  }
+
+  /// Gives a coroutine identity a name, for use in reports. Declaring a `frame_budget`
+  /// does this too.
+  void set_coroutine_name(const void* identity, std::string name);
+
+  /// A human-readable name for a coroutine identity: the name given to
+  /// `set_coroutine_name` if there is one, else the demangled name of the function it
+  /// points to if dladdr can find it, otherwise the address in hex. Compilers usually
+  /// give those functions internal linkage, so don't count on dladdr.
+  std::string coroutine_name(const void* identity);
+}  // namespace toby
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+namespace toby {
+  /// Declares the largest coroutine frame a generator is expected to need.
+  ///
+  /// Yielding one of these doesn't suspend the generator or produce an element:
+  ///
+  ///     generator<int> parse(...) {
+  ///       co_yield toby::frame_budget{"parse", 256};
+  ///       ...
+  ///     }
+  ///
+  /// When frame recording is enabled (see `frame_registry`) it names the coroutine in
+  /// the registry and checks the size of the frame against `max_bytes`. Otherwise it
+  /// does nothing at all.
+  struct frame_budget {
+    const char* name;
+    std::size_t max_bytes;
+  };
+}  // namespace toby
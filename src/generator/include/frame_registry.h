@@ -0,0 +1,69 @@
+#pragma once
+
+#include "coroutine_identity.h"
+#include "frame_budget.h"
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace toby {
+  /// Sizes of the coroutine frames allocated for one coroutine function.
+  struct frame_stats {
+    const void* identity;
+    std::string name;
+    std::size_t frames;
+    std::size_t min_bytes;
+    std::size_t max_bytes;
+    std::size_t budget;  // 0 if no budget has been declared
+  };
+
+  /// Process-wide record of the frame size of every generator coroutine, keyed by
+  /// `coroutine_identity`.
+  ///
+  /// Generators only feed the registry in translation units compiled with
+  /// `TOBY_GENERATOR_FRAME_REGISTRY` defined to 1, in which case their promise_type
+  /// captures the size passed to its `operator new`. Frames whose allocation the
+  /// compiler elided never reach operator new, so they aren't recorded or checked. The
+  /// macro must have the same value in every translation unit of a program.
+  class frame_registry {
+   public:
+    /// Called when a frame is larger than the budget its coroutine declared. The default
+    /// handler writes a message to stderr and, unless NDEBUG is defined, aborts.
+    using budget_handler = std::function<void(const frame_stats&, std::size_t bytes)>;
+
+    static frame_registry& instance();
+
+    void record(const void* identity, std::size_t bytes);
+    void check(const void* identity, std::size_t bytes, const frame_budget& budget);
+
+    /// Replaces the budget handler, returning the previous one.
+    budget_handler set_budget_handler(budget_handler handler);
+
+    std::vector<frame_stats> snapshot() const;
+    void dump(std::ostream& os) const;
+    void clear();
+
+   private:
+    frame_registry();
+
+    frame_stats& entry(const void* identity);
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<const void*, frame_stats> m_entries;
+    budget_handler m_handler;
+  };
+
+  namespace detail {
+    /// The size most recently passed to a promise_type's operator new on this thread,
+    /// picked up by the promise once it has been constructed, which resets it to 0.
+    inline std::size_t& last_frame_size() {
+      static thread_local std::size_t size = 0;
+      return size;
+    }
+  }  // namespace detail
+}  // namespace toby
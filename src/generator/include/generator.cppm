@@ -0,0 +1,54 @@
+// The `toby.generator` module: everything generator.h declares, and the counting and
+// tracing instrumentation policies, for TUs that would rather `import toby.generator;`
+// than parse generator.h and range-v3 on every build.
+//
+// Macros don't cross a module boundary, so the module is built with the `generator`
+// target's own configuration (TOBY_GENERATOR_COROUTINES_TS, TOBY_GENERATOR_USDT) and
+// TOBY_GENERATOR_FRAME_REGISTRY can't be turned on per importer. An importer that also
+// uses range-v3 views still includes range-v3 itself.
+
+module;
+
+#include "generator.h"
+#include "generator_stats.h"
+#include "generator_trace.h"
+
+export module toby.generator;
+
+export namespace toby {
+  using toby::coroutine_counters;
+  using toby::coroutine_identity;
+  using toby::coroutine_name;
+  using toby::counting_instrumentation;
+  using toby::elements_of;
+  using toby::elements_of_range;
+  using toby::emplace;
+  using toby::emplace_args;
+  using toby::frame_budget;
+  using toby::generator;
+  using toby::generator_iterator;
+  using toby::generator_sentinel;
+  using toby::generator_stats;
+  using toby::intrusive_coroutine_handle;
+  using toby::intrusive_coroutine_handle_add_ref;
+  using toby::intrusive_coroutine_handle_release;
+  using toby::no_instrumentation;
+  using toby::operator==;
+  using toby::operator!=;
+  using toby::set_coroutine_name;
+  using toby::trace_event;
+  using toby::trace_instrumentation;
+  using toby::trace_recorder;
+}  // namespace toby
+
+// Declarations in the global module fragment are only kept if something in the module
+// refers to them, so refer to the specialisations that make a generator a range for
+// std::ranges and for the old range-v3.
+#if defined(__cpp_lib_ranges)
+static_assert(std::ranges::enable_view<toby::generator<int>>);
+#endif
+#if !defined(RANGE_V3_VERSION) || RANGE_V3_VERSION < 200
+using generator_common_iterator =
+    ranges::common_type<toby::generator_iterator<toby::generator<int>::promise_type>,
+                        toby::generator_sentinel>::type;
+#endif
@@ -1,17 +1,51 @@
 #pragma once
 
 #include <iterator>
+#include <new>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 
+#include "frame_budget.h"
+#if TOBY_GENERATOR_FRAME_REGISTRY
+#include "frame_registry.h"
+#endif
+
+// USDT (SystemTap/bpftrace) probes for the life of every generator frame, under the
+// provider `toby_generator`: create, resume, yield, complete and destroy. Each has the
+// frame address and the coroutine identity (see coroutine_identity.h) as arguments.
+// While nothing is attached a probe is a single nop; without TOBY_GENERATOR_USDT there
+// is nothing at all.
+#if TOBY_GENERATOR_USDT
+#include <sys/sdt.h>
+#include "coroutine_identity.h"
+#define TOBY_GENERATOR_PROBE(name, frame) \
+  DTRACE_PROBE2(toby_generator, name, frame, ::toby::coroutine_identity(frame))
+#else
+#define TOBY_GENERATOR_PROBE(name, frame)
+#endif
+
+// By default generators are C++20 coroutines. Defining TOBY_GENERATOR_COROUTINES_TS
+// builds them against the Coroutines TS's <experimental/coroutine> instead (or, with
+// USE_MY_COROUTINE_HEADER too, against coroutine.h), as older MSVC and Clang need.
+#if TOBY_GENERATOR_COROUTINES_TS
 #if !USE_MY_COROUTINE_HEADER
 #include <experimental/coroutine>
 #else
 #include "coroutine.h"
 #endif
+namespace toby {
+  namespace coro = std::experimental;
+}
+#else
+#include <coroutine>
+namespace toby {
+  namespace coro = std;
+}
+#endif
 
 namespace toby {
-  /// An RAII-style shared-ownership wrapper for
-  /// std::experimental::coroutine_handle.
+  /// An RAII-style shared-ownership wrapper for coro::coroutine_handle.
   ///
   /// Cooperation with the promise object is required in order to maintain the reference
   /// count, ala boost::intrusive_ptr.
@@ -22,7 +56,7 @@ namespace toby {
   template <class PromiseType>
   class intrusive_coroutine_handle {
    public:
-    using handle = std::experimental::coroutine_handle<PromiseType>;
+    using handle = coro::coroutine_handle<PromiseType>;
 
     intrusive_coroutine_handle() : m_coro(nullptr) {}
     intrusive_coroutine_handle(handle coro) : m_coro(coro) {
@@ -67,19 +101,98 @@ namespace toby {
 #endif
   };
 
+  /// The default instrumentation policy for `generator`, which does nothing.
+  ///
+  /// An instrumentation policy is a default-constructible class that each generator's
+  /// promise_type derives from (so an empty policy takes no space). Its members are
+  /// called with the address of the coroutine frame when:
+  ///  - on_create: the frame has been allocated and the generator object created;
+  ///  - on_resume, on_suspend: just before and just after the coroutine is resumed;
+  ///  - on_yield: the coroutine has yielded an element;
+  ///  - on_complete: the coroutine has run to the end of its body;
+  ///  - on_destroy: the frame is about to be freed.
+  struct no_instrumentation {
+    void on_create(const void*) {}
+    void on_resume(const void*) {}
+    void on_suspend(const void*) {}
+    void on_yield(const void*) {}
+    void on_complete(const void*) {}
+    void on_destroy(const void*) {}
+  };
+
+  /// The arguments of `co_yield toby::emplace(args...)`, which constructs the generator's
+  /// next element from them in place rather than constructing it in the coroutine and
+  /// moving it into the promise.
+  template <class... Args>
+  struct emplace_args {
+    std::tuple<Args&&...> args;
+  };
+
+  template <class... Args>
+  emplace_args<Args...> emplace(Args&&... args) {
+    return {std::forward_as_tuple(std::forward<Args>(args)...)};
+  }
+
+  /// A contiguous range of elements for `co_yield toby::elements_of(range)`, which hands
+  /// all of them to the consumer with a single suspension: the consumer's iterator steps
+  /// through the range itself and only resumes the coroutine once it reaches the end.
+  /// The range must stay alive until then, which a temporary in the co_yield
+  /// expression does.
+  template <class T>
+  struct elements_of_range {
+    T* first;
+    T* last;
+  };
+
+  /// Any non-const range with std::data and std::size, such as a std::vector,
+  /// std::array, array or std::span. Consumers get non-const references to the elements
+  /// and may move from them, so a const range is rejected.
+  template <class ContiguousRange>
+  auto elements_of(ContiguousRange&& range)
+      -> elements_of_range<std::remove_pointer_t<decltype(std::data(range))>> {
+    using element_type = std::remove_pointer_t<decltype(std::data(range))>;
+    static_assert(!std::is_const<element_type>::value,
+                  "elements_of needs a non-const range, since consumers may modify or "
+                  "move from its elements");
+    return {std::data(range), std::data(range) + std::size(range)};
+  }
+
+  namespace detail {
+    /// Suspends unless there's nothing to yield.
+    struct suspend_if {
+      bool suspend;
+
+      bool await_ready() const noexcept { return !suspend; }
+      void await_suspend(coro::coroutine_handle<>) const noexcept {}
+      void await_resume() const noexcept {}
+    };
+
+    /// Resumes a generator coroutine, telling its instrumentation policy.
+    template <class PromiseType>
+    void resume(coro::coroutine_handle<PromiseType> coro) {
+      auto& instrumentation = coro.promise().instrumentation();
+      instrumentation.on_resume(coro.address());
+      TOBY_GENERATOR_PROBE(resume, coro.address());
+      coro.resume();
+      instrumentation.on_suspend(coro.address());
+    }
+  }  // namespace detail
+
   template <class PromiseType>
   struct generator_iterator;
 
-  template <class ElementType, class RefCountType = int>
+  template <class ElementType,
+            class RefCountType    = int,
+            class Instrumentation = no_instrumentation>
   class generator {
    public:
     struct promise_type;
 
     generator() = default;
-    generator(std::experimental::coroutine_handle<promise_type> coro) : m_coro(coro) {}
+    generator(coro::coroutine_handle<promise_type> coro) : m_coro(coro) {}
 
     auto begin() {
-      m_coro->resume();
+      detail::resume(*m_coro);
       return generator_iterator<promise_type>{*m_coro};
     }
     auto end() { return generator_sentinel{}; }
@@ -88,25 +201,133 @@ namespace toby {
     intrusive_coroutine_handle<promise_type> m_coro;
   };
 
-  template <class ElementType, class RefCountType>
-  struct generator<ElementType, RefCountType>::promise_type {
-    ElementType currentElement;
+  template <class ElementType, class RefCountType, class Instrumentation>
+  struct generator<ElementType, RefCountType, Instrumentation>::promise_type
+      : Instrumentation {
+    using element_type = ElementType;
+
     RefCountType ref_count{0};
+#if TOBY_GENERATOR_FRAME_REGISTRY
+    // 0 if the frame's allocation was elided, as it then never reached operator new.
+    std::size_t frame_size = std::exchange(detail::last_frame_size(), 0);
+
+    static void* operator new(std::size_t size) {
+      detail::last_frame_size() = size;
+      return ::operator new(size);
+    }
+    static void operator delete(void* p, std::size_t size) { ::operator delete(p, size); }
+#endif
+
+    ~promise_type() {
+      TOBY_GENERATOR_PROBE(destroy, frame_address());
+      this->on_destroy(frame_address());
+      destroy_element();
+    }
+
+    /// The element yielded last or, after `co_yield elements_of(range)`, the first
+    /// element of the range.
+    ElementType* current_element() { return m_current; }
+    /// The end of the range yielded with elements_of, or null after yielding a single
+    /// element.
+    ElementType* range_end() { return m_range_end; }
+
+    Instrumentation& instrumentation() { return *this; }
+    void* frame_address() {
+      return coro::coroutine_handle<promise_type>::from_promise(*this).address();
+    }
 
     void add_ref() { ++ref_count; }
     auto del_ref() { return --ref_count; }
 
     generator get_return_object() {
-      return generator{
-          std::experimental::coroutine_handle<promise_type>::from_promise(*this)};
+      auto coro = coro::coroutine_handle<promise_type>::from_promise(*this);
+#if TOBY_GENERATOR_FRAME_REGISTRY
+      if (frame_size) {
+        frame_registry::instance().record(coroutine_identity(coro.address()), frame_size);
+      }
+#endif
+      TOBY_GENERATOR_PROBE(create, coro.address());
+      this->on_create(coro.address());
+      return generator{coro};
+    }
+    auto initial_suspend() { return coro::suspend_always{}; }
+    auto yield_value(const ElementType& element) {
+      construct_element(element);
+      return element_yielded();
     }
-    auto initial_suspend() { return std::experimental::suspend_always{}; }
-    auto yield_value(ElementType element) {
-      currentElement = std::move(element);
-      return std::experimental::suspend_always{};
+    auto yield_value(ElementType&& element) {
+      construct_element(std::move(element));
+      return element_yielded();
+    }
+    template <class... Args>
+    auto yield_value(emplace_args<Args...> arguments) {
+      std::apply(
+          [this](Args&&... args) { construct_element(std::forward<Args>(args)...); },
+          std::move(arguments.args));
+      return element_yielded();
+    }
+    template <class T>
+    detail::suspend_if yield_value(elements_of_range<T> range) {
+      static_assert(std::is_same<T, ElementType>::value,
+                    "elements_of needs a non-const range of the element type");
+      destroy_element();
+      if (range.first == range.last) return {false};
+      m_current   = range.first;
+      m_range_end = range.last;
+      element_yielded();
+      return {true};
+    }
+    auto yield_value(const frame_budget& budget) {
+#if TOBY_GENERATOR_FRAME_REGISTRY
+      if (frame_size) {
+        frame_registry::instance().check(coroutine_identity(frame_address()), frame_size,
+                                         budget);
+      }
+#else
+      (void)budget;
+#endif
+      return coro::suspend_never{};
     }
     void return_void() {}
-    auto final_suspend() { return std::experimental::suspend_always{}; }
+    void unhandled_exception() { throw; }
+    auto final_suspend() noexcept {
+      if (m_range_end) {
+        m_current   = nullptr;
+        m_range_end = nullptr;
+      }
+      TOBY_GENERATOR_PROBE(complete, frame_address());
+      this->on_complete(frame_address());
+      return coro::suspend_always{};
+    }
+
+   private:
+    // The current element lives in uninitialised storage so that ElementType needn't be
+    // default-constructible or assignable. It is constructed in place by yield_value
+    // and destroyed when the next one replaces it or the frame is destroyed, so a
+    // reference to it stays valid across the increment that ends the sequence. While
+    // m_range_end is set, m_current instead points into a range yielded with
+    // elements_of, which the promise doesn't own.
+    template <class... Args>
+    void construct_element(Args&&... args) {
+      destroy_element();
+      m_current =
+          ::new (static_cast<void*>(m_storage)) ElementType(std::forward<Args>(args)...);
+    }
+    void destroy_element() {
+      if (m_current && !m_range_end) m_current->~ElementType();
+      m_current   = nullptr;
+      m_range_end = nullptr;
+    }
+
+    coro::suspend_always element_yielded() {
+      TOBY_GENERATOR_PROBE(yield, frame_address());
+      this->on_yield(frame_address());
+      return {};
+    }
+
+    ElementType* m_current   = nullptr;
+    ElementType* m_range_end = nullptr;
+    alignas(ElementType) unsigned char m_storage[sizeof(ElementType)];
   };
 
   template <typename PromiseType>
@@ -121,7 +342,7 @@ namespace toby {
 
   template <class PromiseType>
   struct generator_iterator {
-    using ElementType       = decltype(std::declval<PromiseType>().currentElement);
+    using ElementType       = typename PromiseType::element_type;
     using value_type        = ElementType;
     using difference_type   = std::ptrdiff_t;
     using reference         = ElementType&;
@@ -129,10 +350,13 @@ namespace toby {
     using iterator_category = std::input_iterator_tag;
 
     generator_iterator() = default;
-    generator_iterator(std::experimental::coroutine_handle<PromiseType> coro)
-        : m_coro(coro) {}
+    generator_iterator(coro::coroutine_handle<PromiseType> coro) : m_coro(coro) {
+      load();
+    }
 
-    bool operator==(const generator_sentinel&) const { return m_coro.done(); }
+    bool operator==(const generator_sentinel&) const {
+      return !m_range_end && m_coro.done();
+    }
     bool operator!=(const generator_sentinel& other) const { return !(*this == other); }
 
 #if !defined(RANGE_V3_VERSION) || RANGE_V3_VERSION < 200
@@ -142,19 +366,46 @@ namespace toby {
 #endif
 
     generator_iterator& operator++() {
-      m_coro.resume();
+      // Within a range yielded with elements_of, step through it without resuming.
+      if (m_range_end && ++m_current != m_range_end) return *this;
+      resume();
       return *this;
     }
 
     void operator++(int) { ++(*this); }
 
-    reference operator*() const {
-      // This const_cast shouldn't be necessary according to N4663 but VS2017.1 has
-      // promise() const returning a const reference.
-      return const_cast<PromiseType&>(m_coro.promise()).currentElement;
+    reference operator*() const { return *m_current; }
+
+    /// The end of the range yielded with elements_of that the current element is in, or
+    /// null if it was yielded on its own. The elements from the current one up to there
+    /// can be read in place, for instance to search them, until the iterator moves on.
+    ElementType* block_end() const { return m_range_end; }
+
+    /// Steps forward `n` elements at once. All but the last must be before block_end().
+    generator_iterator& skip(std::ptrdiff_t n) {
+      m_current += n - 1;
+      return ++*this;
+    }
+
+    coro::coroutine_handle<PromiseType> m_coro;
+
+   private:
+    // Kept out of operator++ so that the step through an elements_of range is small
+    // enough to inline.
+    void resume() {
+      detail::resume(m_coro);
+      load();
     }
 
-    std::experimental::coroutine_handle<PromiseType> m_coro;
+    // Copies of the promise's element pointers, kept here so that stepping through an
+    // elements_of range only touches the iterator.
+    void load() {
+      m_current   = m_coro.promise().current_element();
+      m_range_end = m_coro.promise().range_end();
+    }
+
+    ElementType* m_current   = nullptr;
+    ElementType* m_range_end = nullptr;
   };
 
   template <class PromiseType>
@@ -170,6 +421,24 @@ namespace toby {
 
 }  // namespace toby
 
+#if defined(__has_include)
+#if __has_include(<version>)
+#include <version>
+#endif
+#endif
+
+// A generator is a std::ranges::view: copying one only copies a reference to the same
+// coroutine. Its iterator and generator_sentinel already model std::input_iterator and
+// std::sentinel_for, so std::views adaptors work on it directly, with no
+// common_iterator in between.
+#if defined(__cpp_lib_ranges)
+#include <ranges>
+
+template <class ElementType, class RefCountType, class Instrumentation>
+inline constexpr bool std::ranges::enable_view<
+    toby::generator<ElementType, RefCountType, Instrumentation>> = true;
+#endif
+
 #include <range/v3/range_fwd.hpp>
 
 #if !defined(RANGE_V3_VERSION) || RANGE_V3_VERSION < 200
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "coroutine_identity.h"
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace toby {
+  /// Runtime counters for one coroutine function, summed over all of its frames.
+  struct coroutine_counters {
+    const void* identity;
+    std::string name;
+    std::uint64_t frames;
+    std::uint64_t resumes;
+    std::uint64_t yields;
+    std::uint64_t completions;
+    /// Time spent inside the coroutine body, including any generators it resumed.
+    std::uint64_t total_ns;
+    /// As total_ns, but excluding time spent in generators it resumed.
+    std::uint64_t self_ns;
+  };
+
+  /// Process-wide counters for generators that use `counting_instrumentation`, keyed
+  /// by `coroutine_identity`.
+  class generator_stats {
+   public:
+    struct entry {
+      std::atomic<std::uint64_t> frames{0};
+      std::atomic<std::uint64_t> resumes{0};
+      std::atomic<std::uint64_t> yields{0};
+      std::atomic<std::uint64_t> completions{0};
+      std::atomic<std::uint64_t> total_ns{0};
+      std::atomic<std::uint64_t> self_ns{0};
+    };
+
+    static generator_stats& instance();
+
+    /// The counters for a coroutine. The reference remains valid for the life of the
+    /// program, so frames look it up once when they're created.
+    entry& lookup(const void* identity);
+
+    std::vector<coroutine_counters> snapshot() const;
+    void dump_text(std::ostream& os) const;
+    void dump_json(std::ostream& os) const;
+
+    /// Zeroes all counters.
+    void reset();
+
+   private:
+    generator_stats() = default;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<const void*, std::unique_ptr<entry>> m_entries;
+  };
+
+  /// A `generator` instrumentation policy that counts resumes, yields and time spent in
+  /// the coroutine body, aggregated per coroutine function in `generator_stats`.
+  ///
+  ///     toby::generator<int, int, toby::counting_instrumentation> parse(...);
+  ///
+  /// Counters are updated with relaxed atomic operations and timed with
+  /// std::chrono::steady_clock (clock_gettime on Linux), costing a few tens of
+  /// nanoseconds per element. Generators using the default `no_instrumentation` pay
+  /// nothing.
+  class counting_instrumentation {
+   public:
+    void on_create(const void* frame);
+    void on_resume(const void*);
+    void on_suspend(const void*);
+    void on_yield(const void*) {
+      m_entry->yields.fetch_add(1, std::memory_order_relaxed);
+    }
+    void on_complete(const void*) {
+      m_entry->completions.fetch_add(1, std::memory_order_relaxed);
+    }
+    void on_destroy(const void*) {}
+
+   private:
+    generator_stats::entry* m_entry = nullptr;
+    std::uint64_t m_resumed_at      = 0;
+    std::uint64_t m_outer_child_ns  = 0;
+  };
+}  // namespace toby
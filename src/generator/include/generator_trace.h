@@ -0,0 +1,127 @@
+#pragma once
+
+#include "coroutine_identity.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace toby {
+  struct trace_event {
+    const void* identity;
+    const void* frame;
+    std::uint64_t begin_ns;
+    /// For a resume, the time the coroutine suspended again; for a completion, equal
+    /// to begin_ns.
+    std::uint64_t end_ns;
+    std::uint32_t thread;
+    bool complete;
+  };
+
+  /// Collects resume/suspend events from generators that use `trace_instrumentation`
+  /// and writes them as Chrome trace_event JSON, which chrome://tracing and Perfetto
+  /// can display.
+  ///
+  /// Each thread records into its own fixed-size single-producer/single-consumer ring
+  /// buffer, so recording takes no locks. When a buffer is full new events are dropped
+  /// and counted rather than blocking the generator. Buffers are drained either all at
+  /// once by `write_chrome_json` or periodically by a background thread started with
+  /// `start_flushing`. When a thread exits its buffer is handed, once drained, to the
+  /// next thread that starts recording, along with its trace thread ID.
+  class trace_recorder {
+   public:
+    static trace_recorder& instance();
+
+    static std::uint64_t now_ns() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+    }
+
+    /// Gives the calling thread a buffer if it doesn't have one yet, so that `record`
+    /// needn't allocate.
+    void attach_thread();
+
+    /// Records an event in the calling thread's buffer, filling in `event.thread`. If
+    /// the thread has no buffer and one can't be made, the event is dropped.
+    void record(trace_event event) noexcept;
+
+    /// Sets the number of events each thread can buffer. Only affects threads that
+    /// haven't recorded anything yet. Rounded up to a power of two.
+    void set_buffer_capacity(std::size_t events);
+
+    /// Drains all buffered events and writes them as a complete trace document.
+    void write_chrome_json(std::ostream& os);
+
+    /// Starts a thread that drains the buffers into `path` every `period`, so that
+    /// recording threads only ever touch their own buffers.
+    void start_flushing(const std::string& path, std::chrono::milliseconds period =
+                                                     std::chrono::milliseconds(100));
+    /// Drains the buffers a final time and completes the file.
+    void stop_flushing();
+
+    /// The number of events dropped because a thread's buffer was full.
+    std::uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+   private:
+    class thread_buffer;
+
+    trace_recorder();
+    ~trace_recorder();
+
+    class buffer_owner;
+
+    thread_buffer* local_buffer(bool attach);
+    std::vector<trace_event> drain();
+    void write_events(std::ostream& os, const std::vector<trace_event>& events);
+
+    std::mutex m_buffers_mutex;
+    std::vector<std::unique_ptr<thread_buffer>> m_buffers;
+    // Buffers of threads that have exited, some of which may not be drained yet.
+    std::vector<thread_buffer*> m_free;
+    std::size_t m_capacity;
+    std::atomic<std::uint64_t> m_dropped{0};
+
+    std::mutex m_flush_mutex;
+    std::condition_variable m_flush_cv;
+    std::thread m_flusher;
+    std::ofstream m_file;
+    bool m_flushing    = false;
+    bool m_first_event = true;
+  };
+
+  /// A `generator` instrumentation policy that records a trace event for every
+  /// resumption of the coroutine, and one when it completes, in `trace_recorder`.
+  class trace_instrumentation {
+   public:
+    void on_create(const void*) {}
+    void on_resume(const void*) {
+      // The coroutine may complete in this resumption, and on_complete is called where
+      // it can't throw.
+      trace_recorder::instance().attach_thread();
+      m_resumed_at = trace_recorder::now_ns();
+    }
+    void on_suspend(const void* frame) {
+      trace_recorder::instance().record({coroutine_identity(frame), frame, m_resumed_at,
+                                         trace_recorder::now_ns(), 0, false});
+    }
+    void on_yield(const void*) {}
+    void on_complete(const void* frame) {
+      auto now = trace_recorder::now_ns();
+      trace_recorder::instance().record(
+          {coroutine_identity(frame), frame, now, now, 0, true});
+    }
+    void on_destroy(const void*) {}
+
+   private:
+    std::uint64_t m_resumed_at = 0;
+  };
+}  // namespace toby
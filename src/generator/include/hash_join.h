@@ -0,0 +1,240 @@
+#pragma once
+
+#include "generator.h"
+#include "spill_file.h"
+
+#include <range/v3/range_for.hpp>
+#include <range/v3/range_traits.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace toby {
+  namespace detail {
+    /// Mixes a key's std::hash, which is the identity for integers, so that its low
+    /// bits (which pick a table slot) and its high bits (which pick a spill partition)
+    /// are both well spread.
+    inline std::uint64_t mix_hash(std::size_t hash) {
+      std::uint64_t h = hash;
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdull;
+      h ^= h >> 33;
+      return h;
+    }
+
+    /// The build side of a hash join: its rows, and an open-addressing table over them
+    /// with linear probing. A slot holds a row's full hash as well as its index, so
+    /// that probing walks a run of adjacent 16-byte slots and only reads a row when the
+    /// hashes match. The table is at most half full.
+    template <class Row, class KeyFn>
+    class join_table {
+     public:
+      using key_type = std::decay_t<decltype(std::declval<KeyFn&>()(
+          std::declval<const Row&>()))>;
+
+      explicit join_table(KeyFn& key) : m_key(&key) {}
+
+      /// About how many bytes `rows` rows take once indexed.
+      static std::size_t footprint(std::size_t rows) {
+        return rows * (sizeof(Row) + 2 * sizeof(slot));
+      }
+
+      static std::uint64_t hash(const key_type& key) {
+        return mix_hash(std::hash<key_type>()(key));
+      }
+
+      /// The rows, which may be added to until the table is indexed.
+      std::vector<Row>& rows() { return m_rows; }
+
+      void index() {
+        std::size_t size = 2;
+        while (size < 2 * m_rows.size()) size *= 2;
+        m_slots.assign(size, slot{0, empty});
+        m_mask = size - 1;
+        for (std::size_t row = 0; row < m_rows.size(); ++row) {
+          auto h = hash((*m_key)(m_rows[row]));
+          auto i = static_cast<std::size_t>(h) & m_mask;
+          while (m_slots[i].row != empty) i = (i + 1) & m_mask;
+          m_slots[i] = slot{h, row};
+        }
+      }
+
+      /// Where the probe for a key with hash `h` starts.
+      std::size_t first(std::uint64_t h) const {
+        return static_cast<std::size_t>(h) & m_mask;
+      }
+
+      /// The next row from slot `i` on whose key, with hash `h`, equals `key`, moving
+      /// `i` past it; or null once the probe reaches an empty slot.
+      template <class Key>
+      const Row* next(std::size_t& i, std::uint64_t h, const Key& key) const {
+        for (;;) {
+          const slot& s = m_slots[i];
+          i             = (i + 1) & m_mask;
+          if (s.row == empty) return nullptr;
+          if (s.hash == h && (*m_key)(m_rows[s.row]) == key) return &m_rows[s.row];
+        }
+      }
+
+     private:
+      struct slot {
+        std::uint64_t hash;
+        std::size_t row;
+      };
+      static constexpr std::size_t empty = std::numeric_limits<std::size_t>::max();
+
+      KeyFn* m_key;
+      std::vector<Row> m_rows;
+      std::vector<slot> m_slots;
+      std::size_t m_mask = 0;
+    };
+
+    /// How many partitions each side is split into when the build side is spilled.
+    constexpr unsigned join_partitions = 32;
+    /// How many times a partition that is still too big is split again before it's
+    /// joined in memory anyway, as it is when most of its rows share one key.
+    constexpr unsigned max_join_splits = 4;
+
+    /// The partition of hash `h` when splitting for the `depth`th time, which uses
+    /// different bits each time so that a partition's rows don't all land in one of
+    /// its own partitions.
+    inline unsigned join_partition_of(std::uint64_t h, unsigned depth) {
+      return static_cast<unsigned>(h >> (64 - 5 * (depth + 1))) % join_partitions;
+    }
+
+    template <class Build, class Probe, class BuildRange, class ProbeRange,
+              class BuildKey, class ProbeKey>
+    generator<std::pair<Build, Probe>> hash_join(BuildRange build, ProbeRange probe,
+                                                 BuildKey key_build, ProbeKey key_probe,
+                                                 std::size_t memory_budget,
+                                                 std::filesystem::path tmpdir,
+                                                 unsigned depth) {
+      using table_type = join_table<Build, BuildKey>;
+      constexpr bool spillable = std::is_trivially_copyable<Build>::value &&
+                                 std::is_trivially_copyable<Probe>::value;
+
+      table_type table(key_build);
+      auto& rows = table.rows();
+      // Each partition's write buffer, and each side's read buffer while joining one.
+      auto buffer_bytes =
+          std::max<std::size_t>(memory_budget / 2 / join_partitions, 4096);
+      std::vector<spill_writer<Build>> build_parts;
+      std::vector<std::size_t> build_sizes(join_partitions);
+      auto spill_build = [&](const Build& x) {
+        auto p = join_partition_of(table_type::hash(key_build(x)), depth);
+        build_parts[p].push(x);
+        ++build_sizes[p];
+      };
+      RANGES_FOR(auto&& x, build) {
+        if (!build_parts.empty()) {
+          spill_build(x);
+          continue;
+        }
+        rows.push_back(std::forward<decltype(x)>(x));
+        if (table_type::footprint(rows.size()) <= memory_budget ||
+            depth == max_join_splits) {
+          continue;
+        }
+        if constexpr (spillable) {
+          if (tmpdir.empty()) tmpdir = std::filesystem::temp_directory_path();
+          for (unsigned p = 0; p < join_partitions; ++p) {
+            build_parts.emplace_back(tmpdir, buffer_bytes / sizeof(Build));
+          }
+          for (auto& row : rows) spill_build(row);
+          rows = std::vector<Build>();
+        } else {
+          throw std::length_error(
+              "hash_join: the build side exceeds memory_budget and can't be spilled");
+        }
+      }
+
+      if (build_parts.empty()) {
+        table.index();
+        RANGES_FOR(auto&& x, probe) {
+          auto&& key = key_probe(x);
+          auto h     = table_type::hash(key);
+          auto i     = table.first(h);
+          while (auto* row = table.next(i, h, key)) co_yield emplace(*row, x);
+        }
+        co_return;
+      }
+
+      if constexpr (spillable) {
+        std::vector<std::unique_ptr<spill_file>> build_files;
+        for (auto& part : build_parts) build_files.push_back(part.finish());
+        build_parts.clear();
+
+        // Probe rows whose build partition is empty can't match, so aren't kept.
+        std::vector<std::unique_ptr<spill_writer<Probe>>> probe_parts(join_partitions);
+        for (unsigned p = 0; p < join_partitions; ++p) {
+          if (build_sizes[p] != 0) {
+            probe_parts[p] = std::make_unique<spill_writer<Probe>>(
+                tmpdir, buffer_bytes / sizeof(Probe));
+          }
+        }
+        RANGES_FOR(auto&& x, probe) {
+          auto p = join_partition_of(table_type::hash(key_probe(x)), depth);
+          if (probe_parts[p]) probe_parts[p]->push(x);
+        }
+        std::vector<std::unique_ptr<spill_file>> probe_files(join_partitions);
+        for (unsigned p = 0; p < join_partitions; ++p) {
+          if (probe_parts[p]) probe_files[p] = probe_parts[p]->finish();
+        }
+        probe_parts.clear();
+
+        for (unsigned p = 0; p < join_partitions; ++p) {
+          if (build_sizes[p] == 0) continue;
+          RANGES_FOR(auto&& match,
+                     (detail::hash_join<Build, Probe>(
+                         read_spill<Build>(*build_files[p], buffer_bytes / sizeof(Build)),
+                         read_spill<Probe>(*probe_files[p], buffer_bytes / sizeof(Probe)),
+                         key_build, key_probe, memory_budget, tmpdir, depth + 1))) {
+            co_yield std::move(match);
+          }
+          build_files[p].reset();
+          probe_files[p].reset();
+        }
+      }
+    }
+  }  // namespace detail
+
+  /// An inner equi-join of two ranges: yields a pair of (build row, probe row) for
+  /// every build row and probe row whose keys, `key_build(build row)` and
+  /// `key_probe(probe row)`, are equal. The keys are hashed with std::hash of
+  /// key_build's result type, and compared with ==.
+  ///
+  /// The whole of `build` is read into an open-addressing hash table first, so it
+  /// should be the smaller side. `probe` is then streamed through the table and its
+  /// matches yielded as it goes, in the order of the probe rows.
+  ///
+  /// If the table would take more than about `memory_budget` bytes, the join is done
+  /// by grace hashing instead: both sides are split by the hash of their keys into
+  /// partitions spilled to temporary files in `tmpdir` (by default, the system's
+  /// temporary directory), and each partition's build rows are then joined with its
+  /// probe rows in turn, splitting again any that is still too big. The matches are
+  /// then yielded partition by partition rather than in probe order. Rows are spilled
+  /// as raw bytes, so this needs both row types to be trivially copyable; if either
+  /// isn't, exceeding the budget throws std::length_error. The files are removed as
+  /// each partition is done, or when the generator is destroyed.
+  template <class BuildRange, class ProbeRange, class BuildKey, class ProbeKey>
+  auto hash_join(BuildRange build, ProbeRange probe, BuildKey key_build,
+                 ProbeKey key_probe,
+                 std::size_t memory_budget = std::numeric_limits<std::size_t>::max(),
+                 std::filesystem::path tmpdir = {})
+      -> generator<std::pair<ranges::range_value_t<BuildRange>,
+                             ranges::range_value_t<ProbeRange>>> {
+    return detail::hash_join<ranges::range_value_t<BuildRange>,
+                             ranges::range_value_t<ProbeRange>>(
+        std::move(build), std::move(probe), std::move(key_build), std::move(key_probe),
+        memory_budget, std::move(tmpdir), 0);
+  }
+}  // namespace toby
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "batch_channel.h"
+#include "generator.h"
+#include "thread_pool.h"
+
+#include <range/v3/range_for.hpp>
+#include <range/v3/range_traits.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace toby {
+  namespace detail {
+    /// Maps a hash onto [0, partitions), mixing it first since std::hash is the
+    /// identity for integers.
+    inline std::size_t partition_of(std::size_t hash, std::size_t partitions) {
+      std::uint64_t mixed = static_cast<std::uint64_t>(hash) * 0x9e3779b97f4a7c15ull;
+      return static_cast<std::size_t>(((mixed >> 32) * partitions) >> 32);
+    }
+  }  // namespace detail
+
+  /// Splits `range` into `partitions` streams by the hash of `key(element)`, and calls
+  /// `consume(partition, stream)` for each on its own thread, where `stream` is a
+  /// generator of that partition's elements. Equal keys always go to the same
+  /// partition, so each consumer can aggregate its keys without synchronisation.
+  ///
+  /// The elements are pulled on the calling thread and gathered into a batch per
+  /// partition of at least `batch_size` elements, rounded up to fill whole cache lines.
+  /// Full batches go to the consumers through single-producer single-consumer queues of
+  /// `queue_depth` batches, and when a consumer's queue is full the partitioning waits
+  /// for it. A consumer may stop early, in which case the rest of its partition is
+  /// dropped. Returns once every consumer has returned; if one of them, or the range,
+  /// throws, the rest are stopped and the first exception is rethrown.
+  template <class InputRange, class KeyFn, class Consume>
+  void hash_partition(InputRange range, unsigned partitions, KeyFn key, Consume consume,
+                      std::size_t batch_size = 256, std::size_t queue_depth = 4) {
+    using element_type = ranges::range_value_t<InputRange>;
+    using key_type     = std::decay_t<decltype(key(std::declval<element_type&>()))>;
+
+    partitions = std::max(partitions, 1u);
+    std::vector<std::unique_ptr<batch_channel<element_type>>> channels;
+    for (unsigned p = 0; p < partitions; ++p) {
+      channels.push_back(
+          std::make_unique<batch_channel<element_type>>(batch_size, queue_depth));
+    }
+
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    std::atomic<bool> failed{false};
+    auto fail = [&](std::exception_ptr e) {
+      {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) error = e;
+      }
+      failed.store(true);
+      for (auto& channel : channels) channel->cancel();
+    };
+
+    {
+      thread_pool consumers(partitions);
+      for (unsigned p = 0; p < partitions; ++p) {
+        consumers.submit([&, p] {
+          try {
+            consume(static_cast<std::size_t>(p), channels[p]->stream());
+          } catch (...) {
+            fail(std::current_exception());
+          }
+          // Anything still to come for this partition will be dropped.
+          channels[p]->cancel();
+        });
+      }
+
+      try {
+        std::hash<key_type> hash;
+        RANGES_FOR(auto&& x, range) {
+          auto p = detail::partition_of(hash(key(x)), partitions);
+          if (!channels[p]->push(std::forward<decltype(x)>(x)) && failed.load()) break;
+        }
+      } catch (...) {
+        fail(std::current_exception());
+      }
+      for (auto& channel : channels) channel->close();
+    }  // joins the consumers
+
+    if (error) std::rethrow_exception(error);
+  }
+}  // namespace toby
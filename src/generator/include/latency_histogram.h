@@ -0,0 +1,104 @@
+#pragma once
+
+#include "generator.h"
+
+#include <range/v3/range_for.hpp>
+#include <range/v3/range_traits.hpp>
+#include <range/v3/utility/functional.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace toby {
+  /// Counts of recorded values in log-linear buckets: values below 32 each have their
+  /// own bucket and every power of two above that is split into 32 buckets, so a value
+  /// is known to within about 3% (as HdrHistogram does with two significant digits).
+  class histogram_snapshot {
+   public:
+    static constexpr int sub_bucket_bits  = 5;
+    static constexpr int sub_bucket_count = 1 << sub_bucket_bits;
+    static constexpr int bucket_count     = (64 - sub_bucket_bits + 1) * sub_bucket_count;
+
+    static int bucket_index(std::uint64_t value);
+    static std::uint64_t bucket_lowest(int index);
+    static std::uint64_t bucket_highest(int index);
+
+    histogram_snapshot() : m_counts(bucket_count) {}
+
+    void add(int bucket, std::uint64_t count) { m_counts[bucket] += count; }
+    void merge(const histogram_snapshot& other);
+
+    std::uint64_t count() const;
+    std::uint64_t min() const;
+    std::uint64_t max() const;
+    double mean() const;
+    /// The highest value in the bucket containing the given percentile (0-100).
+    std::uint64_t value_at_percentile(double percentile) const;
+
+    /// Writes the count, mean, max and a ladder of percentiles on one line.
+    void write_summary(std::ostream& os) const;
+
+   private:
+    std::vector<std::uint64_t> m_counts;
+  };
+
+  /// A histogram that any number of threads can record into concurrently without
+  /// locking: each thread records into its own shard of relaxed atomic counters, and
+  /// `snapshot` merges the shards.
+  class latency_histogram {
+   public:
+    latency_histogram();
+    latency_histogram(const latency_histogram&) = delete;
+    latency_histogram& operator=(const latency_histogram&) = delete;
+    ~latency_histogram();
+
+    void record(std::uint64_t value) {
+      local_shard()[histogram_snapshot::bucket_index(value)].fetch_add(
+          1, std::memory_order_relaxed);
+    }
+    void record(std::chrono::nanoseconds duration) {
+      record(static_cast<std::uint64_t>(duration.count()));
+    }
+
+    histogram_snapshot snapshot() const;
+
+   private:
+    struct shard {
+      std::atomic<std::uint64_t> counts[histogram_snapshot::bucket_count];
+    };
+
+    std::atomic<std::uint64_t>* local_shard();
+
+    const std::uint64_t m_id;
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::thread::id, std::unique_ptr<shard>> m_shards;
+  };
+
+  /// Passes the elements of `range` through unchanged, recording in `histogram` the
+  /// time taken to produce each one: from when this stage asks the upstream range for
+  /// the next element until it arrives. Time spent downstream, between yielding an
+  /// element and being resumed for the next, isn't counted.
+  template <typename InputRange>
+  auto record_latency(InputRange range, latency_histogram& histogram)
+      -> generator<ranges::range_value_t<InputRange>> {
+    auto requested = std::chrono::steady_clock::now();
+    RANGES_FOR(auto&& x, range) {
+      histogram.record(std::chrono::steady_clock::now() - requested);
+      co_yield x;
+      requested = std::chrono::steady_clock::now();
+    }
+  }
+
+  inline auto record_latency(latency_histogram& histogram) {
+    return ranges::make_pipeable([&histogram](auto&& rng) {
+      return record_latency(std::forward<decltype(rng)>(rng), histogram);
+    });
+  }
+}  // namespace toby
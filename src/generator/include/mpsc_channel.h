@@ -0,0 +1,150 @@
+#pragma once
+
+#include "generator.h"
+#include "spsc_queue.h"
+
+#include <range/v3/range_for.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace toby {
+  /// A channel from any number of producer threads to one consumer, which receives
+  /// the elements as a generator and can feed them straight into a pipeline:
+  ///
+  ///     toby::mpsc_channel<record> ingest;
+  ///     // network threads: ingest.push(r); ... ingest.close();
+  ///     RANGES_FOR(auto&& r, ingest.stream() | filter_co(valid)) store(r);
+  ///
+  /// The queue is an intrusive linked list with a stub node. A push links in a node
+  /// with one atomic exchange of the tail and needs no lock, and push_batch links in a
+  /// whole chain of nodes with one exchange. The consumer only parks on a condition
+  /// variable when the queue is empty. A producer that finds it parked takes the
+  /// mutex to wake it, so a consumer that keeps up never touches the mutex.
+  template <class T>
+  class mpsc_channel {
+    struct node {
+      std::atomic<node*> next{nullptr};
+      std::optional<T> value;
+    };
+
+   public:
+    mpsc_channel() : m_head(new node), m_tail(m_head) {}
+    mpsc_channel(const mpsc_channel&) = delete;
+    mpsc_channel& operator=(const mpsc_channel&) = delete;
+    /// Destroys anything not yet received. Mustn't be called while the stream is being
+    /// consumed or anything is being pushed.
+    ~mpsc_channel() {
+      for (node* n = m_head; n;) delete std::exchange(n, n->next.load());
+    }
+
+    /// Producers: appends an element.
+    template <class U>
+    void push(U&& x) {
+      std::unique_ptr<node> n(new node);
+      n->value.emplace(std::forward<U>(x));
+      node* linked = n.release();
+      link(linked, linked);
+    }
+
+    /// Producers: appends every element of `range`, keeping them together and in order.
+    /// Moves the elements out of the range if it's an rvalue.
+    template <class InputRange>
+    void push_batch(InputRange&& range) {
+      // Owns the nodes until they're linked in, in case the range or an element's
+      // constructor throws.
+      struct chain {
+        node* first = nullptr;
+        node* last  = nullptr;
+        ~chain() {
+          for (node* n = first; n;) {
+            delete std::exchange(n, n->next.load(std::memory_order_relaxed));
+          }
+        }
+      } batch;
+      RANGES_FOR(auto&& x, range) {
+        std::unique_ptr<node> n(new node);
+        if constexpr (std::is_rvalue_reference<InputRange&&>::value) {
+          n->value.emplace(std::move(x));
+        } else {
+          n->value.emplace(x);
+        }
+        if (batch.last) {
+          batch.last->next.store(n.get(), std::memory_order_relaxed);
+        } else {
+          batch.first = n.get();
+        }
+        batch.last = n.release();
+      }
+      if (batch.first) link(std::exchange(batch.first, nullptr), batch.last);
+    }
+
+    /// There will be no more pushes; the stream ends once it has received everything.
+    /// Must be called after every push has returned.
+    void close() {
+      m_closed.store(true);
+      wake();
+    }
+
+    /// Consumer: the elements pushed, in the order their pushes linked them in, until
+    /// the channel is closed. Only one stream may be consumed.
+    generator<T> stream() {
+      for (;;) {
+        node* next = m_head->next.load(std::memory_order_acquire);
+        if (!next && !(next = wait())) co_return;
+        delete m_head;
+        // The node becomes the stub once its value has been received.
+        m_head = next;
+        co_yield std::move(*next->value);
+        next->value.reset();
+      }
+    }
+
+   private:
+    void link(node* first, node* last) {
+      node* prev = m_tail.exchange(last, std::memory_order_acq_rel);
+      // Seq_cst, so that either the consumer sees the node before it parks or this
+      // sees that it has parked.
+      prev->next.store(first);
+      if (m_parked.load()) wake();
+    }
+
+    void wake() {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+      }
+      m_cv.notify_one();
+    }
+
+    /// Waits for the node after the stub, briefly spinning and then parking. Returns
+    /// null if the channel is closed and empty.
+    node* wait() {
+      for (int i = 0; i < 64; ++i) {
+        if (node* next = m_head->next.load(std::memory_order_acquire)) return next;
+        if (m_closed.load()) break;
+      }
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_parked.store(true);
+      node* next = nullptr;
+      m_cv.wait(lock, [&] {
+        next = m_head->next.load();
+        return next || m_closed.load();
+      });
+      m_parked.store(false, std::memory_order_relaxed);
+      return next;
+    }
+
+    // Only used by the consumer.
+    node* m_head;
+    alignas(detail::cache_line) std::atomic<node*> m_tail;
+    std::atomic<bool> m_parked{false};
+    std::atomic<bool> m_closed{false};
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+  };
+}  // namespace toby
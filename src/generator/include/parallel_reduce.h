@@ -0,0 +1,138 @@
+#pragma once
+
+#include "generator.h"
+#include "work_stealing_pool.h"
+
+#include <range/v3/range_for.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace toby {
+  /// A source of elements that parallel_for_each and parallel_reduce can divide between
+  /// threads: a coroutine `make(first, last)` generating the elements for the indices
+  /// [first, last), and that range of indices, which is halved until the pieces are no
+  /// bigger than `grain`. Each piece gets its own generator.
+  ///
+  /// Any other type with the same divisible(), split() and generate() members can be
+  /// used as a source as well.
+  template <class Make, class Index>
+  class splittable_range {
+   public:
+    splittable_range(Make make, Index first, Index last, Index grain)
+        : m_make(std::move(make)),
+          m_first(first),
+          m_last(last),
+          m_grain(std::max<Index>(grain, 1)) {}
+
+    Index size() const { return m_last - m_first; }
+
+    /// Whether the range is big enough to be worth splitting.
+    bool divisible() const { return size() > m_grain; }
+
+    /// The first and second halves of the range.
+    std::pair<splittable_range, splittable_range> split() const {
+      Index middle = m_first + size() / 2;
+      return {{m_make, m_first, middle, m_grain}, {m_make, middle, m_last, m_grain}};
+    }
+
+    /// A generator of the range's elements.
+    auto generate() const { return m_make(m_first, m_last); }
+
+   private:
+    Make m_make;
+    Index m_first;
+    Index m_last;
+    Index m_grain;
+  };
+
+  template <class Make, class Index>
+  splittable_range<Make, Index> make_splittable(Make make, Index first, Index last,
+                                                Index grain) {
+    return {std::move(make), first, last, grain};
+  }
+
+  namespace detail {
+    template <class Source, class Fn>
+    void for_each_piece(work_stealing_pool& pool, const Source& source, Fn& fn) {
+      if (source.divisible()) {
+        auto halves = source.split();
+        pool.spawn([&pool, second = std::move(halves.second), &fn] {
+          for_each_piece(pool, second, fn);
+        });
+        for_each_piece(pool, halves.first, fn);
+        return;
+      }
+      RANGES_FOR(auto&& x, source.generate()) { fn(std::forward<decltype(x)>(x)); }
+    }
+
+    /// A split in a parallel_reduce: the results of its two halves, combined by
+    /// whichever half finishes last and passed up to the split it came from. The root
+    /// has no parent and only one half, which receives the final result.
+    template <class T>
+    struct reduce_node {
+      reduce_node(reduce_node* parent, int side, int halves)
+          : parent(parent), side(side), pending(halves) {}
+
+      reduce_node* const parent;
+      const int side;
+      std::atomic<int> pending;
+      std::optional<T> results[2];
+      std::unique_ptr<reduce_node> children[2];
+    };
+
+    template <class T, class Op>
+    void deliver(reduce_node<T>* node, int side, T result, Op& op) {
+      node->results[side].emplace(std::move(result));
+      while (node->pending.fetch_sub(1, std::memory_order_acq_rel) == 1 && node->parent) {
+        node->parent->results[node->side].emplace(
+            op(std::move(*node->results[0]), std::move(*node->results[1])));
+        node = node->parent;
+      }
+    }
+
+    template <class Source, class T, class Op>
+    void reduce_piece(work_stealing_pool& pool, const Source& source,
+                      reduce_node<T>* node, int side, const T& identity, Op& op) {
+      if (source.divisible()) {
+        auto halves = source.split();
+        node->children[side] = std::make_unique<reduce_node<T>>(node, side, 2);
+        auto* split          = node->children[side].get();
+        pool.spawn([&pool, second = std::move(halves.second), split, &identity, &op] {
+          reduce_piece(pool, second, split, 1, identity, op);
+        });
+        reduce_piece(pool, halves.first, split, 0, identity, op);
+        return;
+      }
+      T result = identity;
+      RANGES_FOR(auto&& x, source.generate()) {
+        result = op(std::move(result), std::forward<decltype(x)>(x));
+      }
+      deliver(node, side, std::move(result), op);
+    }
+  }  // namespace detail
+
+  /// Calls `fn` on every element of `source`, running the generators for the pieces it
+  /// splits into on `pool`'s workers. fn is called concurrently.
+  template <class Source, class Fn>
+  void parallel_for_each(work_stealing_pool& pool, const Source& source, Fn fn) {
+    pool.run([&] { detail::for_each_piece(pool, source, fn); });
+  }
+
+  /// Folds the elements of `source` with `op`, running the generators for the pieces it
+  /// splits into on `pool`'s workers and then combining their results.
+  ///
+  /// Each piece starts from `identity`, which must be an identity for op, and op must be
+  /// associative and callable both as op(T, element) and as op(T, T). The pieces'
+  /// results are combined in the order of the pieces, so op needn't be commutative. If
+  /// op throws, the first exception is rethrown once the other pieces have finished.
+  template <class Source, class T, class Op>
+  T parallel_reduce(work_stealing_pool& pool, const Source& source, T identity, Op op) {
+    detail::reduce_node<T> root(nullptr, 0, 1);
+    pool.run([&] { detail::reduce_piece(pool, source, &root, 0, identity, op); });
+    return std::move(*root.results[0]);
+  }
+}  // namespace toby
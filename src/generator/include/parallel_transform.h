@@ -0,0 +1,292 @@
+#pragma once
+
+#include "generator.h"
+#include "thread_pool.h"
+
+#include <range/v3/range_for.hpp>
+#include <range/v3/range_traits.hpp>
+#include <range/v3/utility/functional.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace toby {
+  namespace detail {
+    template <class InputRange, class Fn>
+    using transform_result_t = std::decay_t<decltype(
+        std::declval<Fn&>()(std::declval<ranges::range_value_t<InputRange>>()))>;
+
+    /// The elements a parallel_transform has in flight: a ring of slots, each holding
+    /// an element until a worker replaces it with its result, and the workers.
+    template <class Input, class Result, class Fn>
+    class transform_window {
+     public:
+      transform_window(Fn& fn, unsigned threads, std::size_t size)
+          : m_fn(fn), m_slots(std::max<std::size_t>(size, 1)), m_pool(threads) {}
+      transform_window(const transform_window&) = delete;
+      transform_window& operator=(const transform_window&) = delete;
+      /// Workers skip the elements still queued, then the pool joins them.
+      ~transform_window() { m_cancelled.store(true, std::memory_order_relaxed); }
+
+      std::size_t size() const { return m_slots.size(); }
+
+      /// Stores element `index` in its slot and queues it for a worker. The slot must
+      /// have been emptied by `take(index - size())`.
+      template <class T>
+      void submit(std::size_t index, T&& input) {
+        slot& s = m_slots[index % m_slots.size()];
+        s.input.emplace(std::forward<T>(input));
+        m_pool.submit([this, &s] { transform(s); });
+      }
+
+      /// Waits for the result for element `index` and moves it out of its slot,
+      /// rethrowing anything fn threw for it.
+      Result take(std::size_t index) {
+        slot& s = m_slots[index % m_slots.size()];
+        {
+          std::unique_lock<std::mutex> lock(m_mutex);
+          m_cv.wait(lock, [&s] { return s.ready; });
+          s.ready = false;
+        }
+        if (s.error) std::rethrow_exception(std::exchange(s.error, nullptr));
+        Result result = std::move(*s.output);
+        s.output.reset();
+        return result;
+      }
+
+     private:
+      struct slot {
+        std::optional<Input> input;
+        std::optional<Result> output;
+        std::exception_ptr error;
+        bool ready = false;
+      };
+
+      void transform(slot& s) {
+        if (!m_cancelled.load(std::memory_order_relaxed)) {
+          try {
+            s.output.emplace(m_fn(std::move(*s.input)));
+          } catch (...) {
+            s.error = std::current_exception();
+          }
+        }
+        s.input.reset();
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          s.ready = true;
+        }
+        m_cv.notify_one();
+      }
+
+      Fn& m_fn;
+      std::vector<slot> m_slots;
+      std::mutex m_mutex;
+      std::condition_variable m_cv;
+      std::atomic<bool> m_cancelled{false};
+      // Last, so that the workers are joined before anything they use is destroyed.
+      thread_pool m_pool;
+    };
+
+    /// The batches an unordered parallel_transform_filter has in flight. The consumer
+    /// fills an input batch and submits it; a worker transforms and filters the whole
+    /// batch into an output batch and queues it, so there is one hand-off per batch
+    /// rather than per element. Buffers of both kinds are recycled.
+    template <class Input, class Result, class Fn, class Pred>
+    class transform_filter_batches {
+     public:
+      transform_filter_batches(Fn& fn, Pred& pred, unsigned threads,
+                               std::size_t batch_size)
+          : m_fn(fn),
+            m_pred(pred),
+            m_batch_size(std::max<std::size_t>(batch_size, 1)),
+            m_inputs(2 * std::max(threads, 1u)),
+            m_pool(threads) {
+        for (auto& input : m_inputs) {
+          input.reserve(m_batch_size);
+          m_free_inputs.push_back(&input);
+        }
+      }
+      transform_filter_batches(const transform_filter_batches&) = delete;
+      transform_filter_batches& operator=(const transform_filter_batches&) = delete;
+      ~transform_filter_batches() { m_cancelled.store(true, std::memory_order_relaxed); }
+
+      std::size_t batch_size() const { return m_batch_size; }
+      /// Whether every input batch is in flight, so `take` must be called before
+      /// `input_batch`.
+      bool full() const { return m_in_flight == m_inputs.size(); }
+      bool empty() const { return m_in_flight == 0; }
+
+      /// An empty batch for the consumer to fill. Mustn't be called when full.
+      std::vector<Input>& input_batch() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto* input = m_free_inputs.back();
+        m_free_inputs.pop_back();
+        return *input;
+      }
+
+      void submit(std::vector<Input>& input) {
+        ++m_in_flight;
+        m_pool.submit([this, &input] { process(input); });
+      }
+
+      /// Waits for any submitted batch to be finished and returns its results, which
+      /// remain valid until the next call to take or try_take.
+      std::vector<Result>& take() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_error || !m_done.empty(); });
+        return pop_done();
+      }
+
+      /// As take, but returns null instead of waiting if no batch is finished.
+      std::vector<Result>* try_take() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_error && m_done.empty()) return nullptr;
+        return &pop_done();
+      }
+
+     private:
+      // Called with m_mutex held.
+      std::vector<Result>& pop_done() {
+        if (m_error) std::rethrow_exception(m_error);
+        m_current.clear();
+        m_spare_outputs.push_back(std::move(m_current));
+        m_current = std::move(m_done.front());
+        m_done.pop_front();
+        --m_in_flight;
+        return m_current;
+      }
+
+      void process(std::vector<Input>& input) {
+        std::vector<Result> output;
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          if (!m_spare_outputs.empty()) {
+            output = std::move(m_spare_outputs.back());
+            m_spare_outputs.pop_back();
+          }
+        }
+        std::exception_ptr error;
+        if (!m_cancelled.load(std::memory_order_relaxed)) {
+          try {
+            for (auto& x : input) {
+              auto result = m_fn(std::move(x));
+              if (m_pred(static_cast<const Result&>(result))) {
+                output.push_back(std::move(result));
+              }
+            }
+          } catch (...) {
+            error = std::current_exception();
+          }
+        }
+        input.clear();
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_free_inputs.push_back(&input);
+          if (error && !m_error) m_error = error;
+          m_done.push_back(std::move(output));
+        }
+        m_cv.notify_one();
+      }
+
+      Fn& m_fn;
+      Pred& m_pred;
+      const std::size_t m_batch_size;
+      std::vector<std::vector<Input>> m_inputs;
+      std::size_t m_in_flight = 0;  // only used by the consumer
+      std::vector<Result> m_current;
+
+      std::mutex m_mutex;
+      std::condition_variable m_cv;
+      std::vector<std::vector<Input>*> m_free_inputs;
+      std::deque<std::vector<Result>> m_done;
+      std::vector<std::vector<Result>> m_spare_outputs;
+      std::exception_ptr m_error;
+      std::atomic<bool> m_cancelled{false};
+      // Last, so that the workers are joined before anything they use is destroyed.
+      thread_pool m_pool;
+    };
+  }  // namespace detail
+
+  /// Applies `fn` to each element of `range` on `threads` worker threads and yields the
+  /// results in the order of the elements.
+  ///
+  /// Elements are pulled from `range` on the consuming thread, and at most `window` are
+  /// in flight at once: pulled, but with their result not yet yielded. Workers call fn
+  /// concurrently, so it mustn't modify shared state without synchronisation. If fn
+  /// throws, the exception is rethrown to the consumer in place of that result.
+  template <class InputRange, class Fn>
+  auto parallel_transform(InputRange range, Fn fn, unsigned threads, std::size_t window)
+      -> generator<detail::transform_result_t<InputRange, Fn>> {
+    using input_type  = ranges::range_value_t<InputRange>;
+    using result_type = detail::transform_result_t<InputRange, Fn>;
+
+    detail::transform_window<input_type, result_type, Fn> in_flight(fn, threads, window);
+    std::size_t submitted = 0;
+    std::size_t yielded   = 0;
+    RANGES_FOR(auto&& x, range) {
+      if (submitted - yielded == in_flight.size()) co_yield in_flight.take(yielded++);
+      in_flight.submit(submitted++, std::forward<decltype(x)>(x));
+    }
+    while (yielded != submitted) co_yield in_flight.take(yielded++);
+  }
+
+  template <class Fn>
+  auto parallel_transform(Fn fn, unsigned threads, std::size_t window) {
+    return ranges::make_pipeable([fn = std::move(fn), threads, window](auto&& rng) {
+      return parallel_transform(std::forward<decltype(rng)>(rng), std::move(fn), threads,
+                                window);
+    });
+  }
+
+  /// Applies `fn` to each element of `range` on `threads` worker threads and yields the
+  /// results for which `pred` is true, in whatever order the workers finish them.
+  ///
+  /// Elements are pulled from `range` on the consuming thread in batches of
+  /// `batch_size`, and each worker transforms and filters a whole batch before handing
+  /// it back, so larger batches mean less synchronisation but more latency. At most two
+  /// batches per thread are in flight. fn and pred are called concurrently on the
+  /// workers. If either throws, the first exception is rethrown to the consumer the
+  /// next time it asks for a finished batch, and batches that had finished but weren't
+  /// yet yielded are dropped.
+  template <class InputRange, class Fn, class Pred>
+  auto parallel_transform_filter(InputRange range, Fn fn, Pred pred, unsigned threads,
+                                 std::size_t batch_size)
+      -> generator<detail::transform_result_t<InputRange, Fn>> {
+    using input_type  = ranges::range_value_t<InputRange>;
+    using result_type = detail::transform_result_t<InputRange, Fn>;
+
+    detail::transform_filter_batches<input_type, result_type, Fn, Pred> batches(
+        fn, pred, threads, batch_size);
+    auto* input = &batches.input_batch();
+    RANGES_FOR(auto&& x, range) {
+      input->push_back(std::forward<decltype(x)>(x));
+      if (input->size() < batches.batch_size()) continue;
+      batches.submit(*input);
+      while (batches.full()) co_yield elements_of(batches.take());
+      while (auto* results = batches.try_take()) co_yield elements_of(*results);
+      input = &batches.input_batch();
+    }
+    if (!input->empty()) batches.submit(*input);
+    while (!batches.empty()) co_yield elements_of(batches.take());
+  }
+
+  template <class Fn, class Pred>
+  auto parallel_transform_filter(Fn fn, Pred pred, unsigned threads,
+                                 std::size_t batch_size) {
+    return ranges::make_pipeable(
+        [fn = std::move(fn), pred = std::move(pred), threads, batch_size](auto&& rng) {
+          return parallel_transform_filter(std::forward<decltype(rng)>(rng),
+                                           std::move(fn), std::move(pred), threads,
+                                           batch_size);
+        });
+  }
+}  // namespace toby
@@ -0,0 +1,195 @@
+#pragma once
+
+#include "batch_channel.h"
+#include "generator.h"
+
+#include <range/v3/range_for.hpp>
+#include <range/v3/range_traits.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace toby {
+  /// How one stage of a pipelined run spent its time.
+  struct stage_stats {
+    /// Elements the stage yielded (for the sink, the elements it consumed).
+    std::size_t elements = 0;
+    /// Seconds from the stage starting to it finishing.
+    double seconds = 0;
+    /// Seconds spent waiting for the stage before to send a batch.
+    double input_wait = 0;
+    /// Seconds spent waiting for the stage after to make room for a batch.
+    double output_wait = 0;
+
+    /// The fraction of its time the stage spent working rather than waiting.
+    double utilisation() const;
+  };
+
+  /// Per-stage timings from a pipelined run: the source first, then each stage, then
+  /// the sink, which is whatever consumes the pipelined generator.
+  struct pipeline_stats {
+    std::vector<stage_stats> stages;
+
+    /// The index of the stage with the highest utilisation: the one the others are
+    /// waiting for.
+    std::size_t bottleneck() const;
+    void dump_text(std::ostream& os) const;
+  };
+
+  struct pipeline_options {
+    /// Elements per batch sent between stages (rounded up to whole cache lines).
+    std::size_t batch_size = 256;
+    /// Full batches that can wait between two stages.
+    std::size_t queue_depth = 4;
+    /// If set, filled in when the pipelined generator completes.
+    pipeline_stats* stats = nullptr;
+  };
+
+  namespace detail {
+    /// The threads and channels of one pipelined run, and the first exception any
+    /// stage threw. Destroying it cancels the channels and joins the threads.
+    class pipeline_run {
+     public:
+      explicit pipeline_run(std::size_t stages) : m_stats(stages) {}
+      pipeline_run(const pipeline_run&) = delete;
+      pipeline_run& operator=(const pipeline_run&) = delete;
+      ~pipeline_run();
+
+      template <class T>
+      batch_channel<T>& add_channel(const pipeline_options& options) {
+        auto channel =
+            std::make_shared<batch_channel<T>>(options.batch_size, options.queue_depth);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cancel.push_back([channel] { channel->cancel(); });
+        return *channel;
+      }
+
+      template <class Fn>
+      void start(Fn fn) {
+        m_threads.emplace_back(std::move(fn));
+      }
+
+      stage_stats& stats(std::size_t stage) { return m_stats[stage]; }
+
+      /// Records the exception stage `stage` threw and cancels the channels before it,
+      /// so that the stages before it stop while the ones after it drain what it sent.
+      void fail(std::size_t stage, std::exception_ptr error);
+
+      /// Joins the stages, copies their stats out, and rethrows the first exception
+      /// any of them threw.
+      void finish(pipeline_stats* stats);
+
+     private:
+      void cancel();
+      void join();
+
+      std::mutex m_mutex;  // guards m_error and m_cancel
+      std::exception_ptr m_error;
+      std::vector<stage_stats> m_stats;
+      // Indexed by the stage that sends to the channel.
+      std::vector<std::function<void()>> m_cancel;
+      std::vector<std::thread> m_threads;
+    };
+
+    template <class Range, class... Stages>
+    struct pipeline_result {
+      using type = ranges::range_value_t<Range>;
+    };
+
+    template <class Range, class Stage, class... Rest>
+    struct pipeline_result<Range, Stage, Rest...> {
+      using stage_input  = generator<ranges::range_value_t<Range>>;
+      using stage_output = decltype(std::declval<Stage&>()(std::declval<stage_input>()));
+      using type         = typename pipeline_result<stage_output, Rest...>::type;
+    };
+
+    template <class Range, class T, class InputWait>
+    void run_stage(pipeline_run& run, std::size_t index, Range& range,
+                   batch_channel<T>& out, InputWait& input_wait) {
+      auto start           = std::chrono::steady_clock::now();
+      std::size_t elements = 0;
+      try {
+        RANGES_FOR(auto&& x, range) {
+          ++elements;
+          if (!out.push(std::forward<decltype(x)>(x))) break;
+        }
+      } catch (...) {
+        run.fail(index, std::current_exception());
+      }
+      out.close();
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      run.stats(index) = {elements, elapsed.count(), input_wait(), out.send_wait()};
+    }
+
+    /// Starts a thread that iterates `range` and sends its elements to a new channel,
+    /// which it returns.
+    template <class InputWait, class Range>
+    auto& start_stages(pipeline_run& run, const pipeline_options& options,
+                       std::size_t index, InputWait input_wait, Range range) {
+      using element_type = ranges::range_value_t<Range>;
+      auto& out          = run.add_channel<element_type>(options);
+      run.start([&run, index, range = std::move(range), &out, input_wait]() mutable {
+        run_stage(run, index, range, out, input_wait);
+      });
+      return out;
+    }
+
+    /// Starts a thread for `range` and one for each stage, applying each stage to the
+    /// stream of elements from the one before, and returns the last stage's channel.
+    template <class InputWait, class Range, class Stage, class... Rest>
+    auto& start_stages(pipeline_run& run, const pipeline_options& options,
+                       std::size_t index, InputWait input_wait, Range range, Stage& stage,
+                       Rest&... rest) {
+      auto& out =
+          start_stages(run, options, index, std::move(input_wait), std::move(range));
+      return start_stages(run, options, index + 1, [&out] { return out.receive_wait(); },
+                          stage(out.stream()), rest...);
+    }
+  }  // namespace detail
+
+  /// Runs `source` and each of `stages` on a thread of its own, and yields the last
+  /// stage's elements to the consuming thread, the sink. Each stage is a function from
+  /// a generator of the previous stage's elements to a range, typically a call to an
+  /// unmodified stage coroutine:
+  ///
+  ///     auto evens = [](auto in) { return co_remove_if(std::move(in), is_even); };
+  ///     for (int x : toby::pipelined(co_ints(0, n), evens, squares)) ...
+  ///
+  /// Stages are connected by batch_channels, so each hand-off costs one lock-free
+  /// queue operation per batch of `options.batch_size` elements, and a stage waits when
+  /// the next one is `options.queue_depth` batches behind. If a stage throws, the stages
+  /// before it are stopped and the exception is rethrown to the sink once the stages
+  /// after it have drained. Destroying the generator early stops every stage.
+  template <class Source, class... Stages>
+  auto pipelined_with(pipeline_options options, Source source, Stages... stages)
+      -> generator<typename detail::pipeline_result<Source, Stages...>::type> {
+    detail::pipeline_run run(sizeof...(Stages) + 2);
+    auto start = std::chrono::steady_clock::now();
+    auto& last = detail::start_stages(run, options, 0, [] { return 0.0; },
+                                      std::move(source), stages...);
+    std::size_t consumed = 0;
+    typename std::decay_t<decltype(last)>::batch received;
+    while (last.receive(received)) {
+      consumed += received.size();
+      co_yield elements_of(received);
+      last.recycle(received);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    run.stats(sizeof...(Stages) + 1) = {consumed, elapsed.count(), last.receive_wait()};
+    run.finish(options.stats);
+  }
+
+  template <class Source, class... Stages>
+  auto pipelined(Source source, Stages... stages)
+      -> generator<typename detail::pipeline_result<Source, Stages...>::type> {
+    return pipelined_with(pipeline_options(), std::move(source), std::move(stages)...);
+  }
+}  // namespace toby
@@ -0,0 +1,254 @@
+#pragma once
+
+#include "generator.h"
+
+#include <range/v3/range_traits.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace toby {
+  namespace detail {
+    /// The first element in [first, last) that isn't less than `bound`, found by
+    /// galloping: comparing with the elements 1, 2, 4, 8... along until one isn't
+    /// less, then binary searching the last step. This takes O(log n) comparisons to
+    /// skip n elements, but only one when the first element already isn't less.
+    template <class T, class Compare>
+    const T* gallop(const T* first, const T* last, const T& bound, Compare& comp) {
+      if (first == last || !comp(*first, bound)) return first;
+      // *lo is always less than bound.
+      const T* lo      = first;
+      std::size_t step = 1;
+      for (;;) {
+        if (static_cast<std::size_t>(last - lo) <= step) {
+          return std::lower_bound(lo + 1, last, bound, comp);
+        }
+        const T* hi = lo + step;
+        if (!comp(*hi, bound)) return std::lower_bound(lo + 1, hi, bound, comp);
+        lo = hi;
+        step *= 2;
+      }
+    }
+
+    /// A position in a sorted contiguous range, such as a std::span or std::vector,
+    /// which is all one block. `T` is const if the range is.
+    template <class T>
+    class span_cursor {
+     public:
+      using value_type = std::remove_const_t<T>;
+
+      span_cursor(T* first, T* last) : m_first(first), m_last(last) {}
+
+      bool empty() const { return m_first == m_last; }
+      T& front() const { return *m_first; }
+      void pop() { ++m_first; }
+
+      /// The elements from the front that can be read in place: here, all of them.
+      T* block_end() const { return m_last; }
+      /// Moves past the first `n` elements, which must be within the block.
+      void skip(std::size_t n) { m_first += n; }
+
+     private:
+      T* m_first;
+      T* m_last;
+    };
+
+    /// A position in a sorted generator. Blocks are the ranges it yields with
+    /// elements_of, which can be searched in place; an element yielded on its own is a
+    /// block of one.
+    template <class Generator>
+    class generator_cursor {
+      using iterator = decltype(std::declval<Generator&>().begin());
+
+     public:
+      using value_type = typename iterator::value_type;
+
+      explicit generator_cursor(Generator& g) : m_it(g.begin()) {}
+
+      bool empty() const { return m_it == generator_sentinel{}; }
+      value_type& front() const { return *m_it; }
+      void pop() { ++m_it; }
+
+      value_type* block_end() const {
+        return m_it.block_end() ? m_it.block_end() : &*m_it + 1;
+      }
+      void skip(std::size_t n) { m_it.skip(static_cast<std::ptrdiff_t>(n)); }
+
+     private:
+      iterator m_it;
+    };
+
+    template <class ElementType, class RefCountType, class Instrumentation>
+    auto sorted_cursor(generator<ElementType, RefCountType, Instrumentation>& g) {
+      return generator_cursor<generator<ElementType, RefCountType, Instrumentation>>(g);
+    }
+
+    template <class ContiguousRange>
+    auto sorted_cursor(ContiguousRange& range) {
+      auto* first = std::data(range);
+      return span_cursor<std::remove_pointer_t<decltype(first)>>(first,
+                                                                first + std::size(range));
+    }
+
+    /// Moves `cursor` past the elements less than `bound`, galloping through each
+    /// block, and returns whether any are left.
+    template <class Cursor, class T, class Compare>
+    bool seek(Cursor& cursor, const T& bound, Compare& comp) {
+      while (!cursor.empty()) {
+        // Checked here, so that an element yielded on its own costs one comparison.
+        const T* first = &cursor.front();
+        if (!comp(*first, bound)) return true;
+        cursor.skip(gallop(first + 1, cursor.block_end(), bound, comp) - first);
+      }
+      return false;
+    }
+
+    /// The cursor's element type, which is const if its source's elements are.
+    template <class Cursor>
+    using cursor_element_t =
+        std::remove_reference_t<decltype(std::declval<Cursor&>().front())>;
+
+    /// The elements at the front of `cursor`'s block that are less than `bound`, to be
+    /// yielded before the cursor is moved past them.
+    template <class Cursor, class T, class Compare>
+    elements_of_range<cursor_element_t<Cursor>> run_below(Cursor& cursor, const T& bound,
+                                                          Compare& comp) {
+      auto* first = &cursor.front();
+      return {first, first + (gallop<T>(first, cursor.block_end(), bound, comp) - first)};
+    }
+
+    /// The rest of `cursor`'s block.
+    template <class Cursor>
+    elements_of_range<cursor_element_t<Cursor>> rest_of_block(Cursor& cursor) {
+      return {&cursor.front(), cursor.block_end()};
+    }
+
+    /// A run to yield with elements_of. The consumer may modify or move from the
+    /// elements it's given, so a run from a const range is first copied into `copies`.
+    template <class T>
+    elements_of_range<T> in_place_or_copied(elements_of_range<T> run, std::vector<T>&) {
+      return run;
+    }
+    template <class T>
+    elements_of_range<T> in_place_or_copied(elements_of_range<const T> run,
+                                            std::vector<T>& copies) {
+      copies.assign(run.first, run.last);
+      return {copies.data(), copies.data() + copies.size()};
+    }
+
+    template <class Range1, class Range2>
+    constexpr bool same_elements =
+        std::is_same<ranges::range_value_t<Range1>, ranges::range_value_t<Range2>>::value;
+  }  // namespace detail
+
+  /// The elements of sorted range `a` that are also in sorted range `b`, in order: as
+  /// std::set_intersection, an element that appears m times in a and n times in b
+  /// appears min(m, n) times. Both ranges must be sorted by `comp` and hold the same
+  /// element type; each may be a toby::generator or a contiguous range such as a
+  /// std::span.
+  ///
+  /// Rather than stepping through both ranges one element at a time, each side skips
+  /// ahead to the other's next element by galloping search, so intersecting a short
+  /// range with a long one takes time proportional to the short one times the log of
+  /// the gaps between its elements. A generator is searched in place within each range
+  /// it yields with elements_of, so generators that yield blocks of elements that way
+  /// are skipped through fastest.
+  template <class Range1, class Range2, class Compare = std::less<>>
+  auto set_intersection(Range1 a, Range2 b, Compare comp = Compare())
+      -> generator<ranges::range_value_t<Range1>> {
+    static_assert(detail::same_elements<Range1, Range2>,
+                  "set_intersection needs ranges of the same element type");
+    auto left  = detail::sorted_cursor(a);
+    auto right = detail::sorted_cursor(b);
+    while (!right.empty() && detail::seek(left, right.front(), comp) &&
+           detail::seek(right, left.front(), comp)) {
+      if (comp(left.front(), right.front())) continue;
+      co_yield left.front();
+      left.pop();
+      right.pop();
+    }
+  }
+
+  /// The elements in either of sorted ranges `a` and `b`, in order: as std::set_union,
+  /// an element that appears m times in a and n times in b appears max(m, n) times.
+  /// The ranges are as for set_intersection.
+  ///
+  /// Runs of one side that fall between two elements of the other are found by
+  /// galloping search and yielded with elements_of, as far as each lies within one
+  /// block of its source, as is the rest of either side once the other runs out. Runs
+  /// from a generator or a non-const range are yielded in place; runs from a const
+  /// range, such as a std::span of const elements, are copied first, since the
+  /// consumer may modify or move from what it's given.
+  template <class Range1, class Range2, class Compare = std::less<>>
+  auto set_union(Range1 a, Range2 b, Compare comp = Compare())
+      -> generator<ranges::range_value_t<Range1>> {
+    static_assert(detail::same_elements<Range1, Range2>,
+                  "set_union needs ranges of the same element type");
+    auto left  = detail::sorted_cursor(a);
+    auto right = detail::sorted_cursor(b);
+    std::vector<ranges::range_value_t<Range1>> copies;
+    while (!left.empty() && !right.empty()) {
+      auto left_run = detail::run_below(left, right.front(), comp);
+      if (left_run.first != left_run.last) {
+        co_yield detail::in_place_or_copied(left_run, copies);
+        left.skip(left_run.last - left_run.first);
+        continue;
+      }
+      auto right_run = detail::run_below(right, left.front(), comp);
+      if (right_run.first != right_run.last) {
+        co_yield detail::in_place_or_copied(right_run, copies);
+        right.skip(right_run.last - right_run.first);
+        continue;
+      }
+      co_yield left.front();
+      left.pop();
+      right.pop();
+    }
+    while (!left.empty()) {
+      auto run = detail::rest_of_block(left);
+      co_yield detail::in_place_or_copied(run, copies);
+      left.skip(run.last - run.first);
+    }
+    while (!right.empty()) {
+      auto run = detail::rest_of_block(right);
+      co_yield detail::in_place_or_copied(run, copies);
+      right.skip(run.last - run.first);
+    }
+  }
+
+  /// The elements of sorted range `a` that aren't in sorted range `b`, in order: as
+  /// std::set_difference, an element that appears m times in a and n times in b
+  /// appears max(m - n, 0) times. The ranges are as for set_intersection.
+  ///
+  /// b skips ahead to each element of a by galloping search, and runs of a that fall
+  /// between two elements of b are found the same way and yielded as for set_union.
+  template <class Range1, class Range2, class Compare = std::less<>>
+  auto set_difference(Range1 a, Range2 b, Compare comp = Compare())
+      -> generator<ranges::range_value_t<Range1>> {
+    static_assert(detail::same_elements<Range1, Range2>,
+                  "set_difference needs ranges of the same element type");
+    auto left  = detail::sorted_cursor(a);
+    auto right = detail::sorted_cursor(b);
+    std::vector<ranges::range_value_t<Range1>> copies;
+    while (!left.empty() && detail::seek(right, left.front(), comp)) {
+      auto run = detail::run_below(left, right.front(), comp);
+      if (run.first == run.last) {
+        left.pop();
+        right.pop();
+        continue;
+      }
+      co_yield detail::in_place_or_copied(run, copies);
+      left.skip(run.last - run.first);
+    }
+    while (!left.empty()) {
+      auto run = detail::rest_of_block(left);
+      co_yield detail::in_place_or_copied(run, copies);
+      left.skip(run.last - run.first);
+    }
+  }
+}  // namespace toby
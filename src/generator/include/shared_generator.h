@@ -0,0 +1,154 @@
+#pragma once
+
+#include "generator.h"
+#include "spsc_queue.h"
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace toby {
+  /// A generator that many threads can take elements from at once, each element going
+  /// to exactly one of them. Each thread takes elements through its own `consumer`.
+  ///
+  /// The generator is only ever resumed by one thread at a time, but there's no mutex
+  /// for the threads to queue on. Instead it uses flat combining. A consumer publishes
+  /// its request in its own record. Whichever consumer then finds the generator free
+  /// becomes the combiner: it serves every published request and marks each one done.
+  /// The other consumers spin on their own record's cache line until theirs is done,
+  /// or until the generator is free and they can combine themselves. Taking batches
+  /// rather than single elements amortises the hand-off further.
+  template <class T>
+  class shared_generator {
+    struct record;
+
+   public:
+    explicit shared_generator(generator<T> source) : m_source(std::move(source)) {}
+    shared_generator(const shared_generator&) = delete;
+    shared_generator& operator=(const shared_generator&) = delete;
+    /// Mustn't be called while there are consumers.
+    ~shared_generator() {
+      for (record* r = m_records.load(); r;) delete std::exchange(r, r->next);
+    }
+
+    /// One thread's handle on a shared_generator. Not itself thread safe.
+    class consumer {
+     public:
+      explicit consumer(shared_generator& shared)
+          : m_shared(shared), m_record(shared.acquire()) {}
+      consumer(const consumer&) = delete;
+      consumer& operator=(const consumer&) = delete;
+      ~consumer() { m_record->in_use.store(false, std::memory_order_release); }
+
+      /// Appends up to `n` elements to `batch` and returns how many. Returns fewer than
+      /// n only once the generator is finished. If the generator threw, rethrows that
+      /// exception instead.
+      std::size_t take(std::vector<T>& batch, std::size_t n) {
+        return m_shared.take(*m_record, batch, n);
+      }
+
+      /// The next element, or nothing once the generator is finished.
+      std::optional<T> next() {
+        m_one.clear();
+        if (take(m_one, 1) == 0) return std::nullopt;
+        return std::move(m_one.front());
+      }
+
+     private:
+      shared_generator& m_shared;
+      record* m_record;
+      std::vector<T> m_one;
+    };
+
+   private:
+    enum : int { idle, pending, done };
+
+    /// A consumer's published request. Records are reused by later consumers and only
+    /// freed with the shared_generator.
+    struct alignas(detail::cache_line) record {
+      std::atomic<int> state{idle};
+      std::atomic<bool> in_use{true};
+      std::vector<T>* batch = nullptr;
+      std::size_t wanted    = 0;
+      std::size_t got       = 0;
+      record* next          = nullptr;
+    };
+
+    record* acquire() {
+      for (record* r = m_records.load(std::memory_order_acquire); r; r = r->next) {
+        bool free = false;
+        if (!r->in_use.load(std::memory_order_relaxed) &&
+            r->in_use.compare_exchange_strong(free, true, std::memory_order_acquire)) {
+          return r;
+        }
+      }
+      auto* r = new record;
+      r->next = m_records.load(std::memory_order_relaxed);
+      while (!m_records.compare_exchange_weak(r->next, r, std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+      }
+      return r;
+    }
+
+    std::size_t take(record& r, std::vector<T>& batch, std::size_t n) {
+      r.batch  = &batch;
+      r.wanted = n;
+      r.state.store(pending, std::memory_order_release);
+      detail::backoff wait;
+      while (r.state.load(std::memory_order_acquire) != done) {
+        if (!m_combining.load(std::memory_order_relaxed) &&
+            !m_combining.exchange(true, std::memory_order_acquire)) {
+          combine();
+          m_combining.store(false, std::memory_order_release);
+        } else {
+          wait.pause();
+        }
+      }
+      r.state.store(idle, std::memory_order_relaxed);
+      if (r.got == 0 && m_error) std::rethrow_exception(m_error);
+      return r.got;
+    }
+
+    // Only called by the combiner.
+    void combine() {
+      for (record* r = m_records.load(std::memory_order_acquire); r; r = r->next) {
+        if (r->state.load(std::memory_order_acquire) != pending) continue;
+        r->got = 0;
+        try {
+          while (r->got < r->wanted && advance()) {
+            r->batch->push_back(std::move(**m_current));
+            ++r->got;
+          }
+        } catch (...) {
+          m_error    = std::current_exception();
+          m_finished = true;
+        }
+        r->state.store(done, std::memory_order_release);
+      }
+    }
+
+    /// Moves to the next element, resuming the generator, unless it's finished.
+    bool advance() {
+      if (m_finished) return false;
+      if (m_current) {
+        ++*m_current;
+      } else {
+        m_current.emplace(m_source.begin());
+      }
+      m_finished = *m_current == m_source.end();
+      return !m_finished;
+    }
+
+    generator<T> m_source;
+    // Only used by the combiner.
+    std::optional<decltype(m_source.begin())> m_current;
+    bool m_finished = false;
+    std::exception_ptr m_error;
+
+    alignas(detail::cache_line) std::atomic<bool> m_combining{false};
+    std::atomic<record*> m_records{nullptr};
+  };
+}  // namespace toby
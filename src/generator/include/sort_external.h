@@ -0,0 +1,209 @@
+#pragma once
+
+#include "generator.h"
+#include "spill_file.h"
+#include "thread_pool.h"
+
+#include <range/v3/range_for.hpp>
+#include <range/v3/range_traits.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace toby {
+  namespace detail {
+    /// Each run being merged gets a read buffer of at least this many bytes, which
+    /// limits how many runs one pass can merge.
+    constexpr std::size_t min_merge_buffer = 64 * 1024;
+
+    /// Calls `fn(i)` for every i below `n` on `pool`'s threads and the calling one, and
+    /// returns once every call has. If any call throws, the first exception is rethrown
+    /// then.
+    template <class Fn>
+    void run_in_parallel(thread_pool& pool, std::size_t n, Fn fn) {
+      std::mutex mutex;
+      std::condition_variable cv;
+      std::size_t finished = 0;
+      std::exception_ptr error;
+      auto call = [&](std::size_t i) {
+        try {
+          fn(i);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (!error) error = std::current_exception();
+        }
+      };
+      for (std::size_t i = 1; i < n; ++i) {
+        // Tasks mustn't throw, and call doesn't.
+        pool.submit([&, i] {
+          call(i);
+          std::lock_guard<std::mutex> lock(mutex);
+          if (++finished == n - 1) cv.notify_one();
+        });
+      }
+      call(0);
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&] { return finished == n - 1; });
+      if (error) std::rethrow_exception(error);
+    }
+
+    /// Sorts on up to hardware_concurrency threads: each sorts a slice, then the
+    /// slices are merged pairwise, back and forth between `v` and `scratch`. The
+    /// threads are `pool`'s, which is started the first time there's more than one
+    /// slice.
+    template <class T, class Compare>
+    void parallel_sort(std::vector<T>& v, std::vector<T>& scratch, Compare& comp,
+                       std::optional<thread_pool>& pool) {
+      constexpr std::size_t min_slice = 1 << 16;
+      unsigned threads   = std::max(1u, std::thread::hardware_concurrency());
+      std::size_t slices = std::min<std::size_t>(
+          threads, std::max<std::size_t>(v.size() / min_slice, 1));
+      if (slices == 1) {
+        std::sort(v.begin(), v.end(), comp);
+        return;
+      }
+      if (!pool) pool.emplace(threads - 1);
+      std::vector<std::size_t> bounds;
+      for (std::size_t i = 0; i <= slices; ++i) bounds.push_back(v.size() * i / slices);
+      run_in_parallel(*pool, slices, [&](std::size_t i) {
+        std::sort(v.begin() + bounds[i], v.begin() + bounds[i + 1], comp);
+      });
+      scratch.resize(v.size());
+      auto* from = &v;
+      auto* to   = &scratch;
+      for (std::size_t width = 1; width < slices; width *= 2) {
+        auto pairs = (slices + 2 * width - 1) / (2 * width);
+        run_in_parallel(*pool, pairs, [&](std::size_t pair) {
+          auto first  = from->begin() + bounds[pair * 2 * width];
+          auto middle = from->begin() + bounds[std::min((pair * 2 + 1) * width, slices)];
+          auto last   = from->begin() + bounds[std::min((pair * 2 + 2) * width, slices)];
+          std::merge(first, middle, middle, last, to->begin() + (first - from->begin()),
+                     comp);
+        });
+        std::swap(from, to);
+      }
+      if (from != &v) v.swap(scratch);
+    }
+
+    template <class T>
+    std::unique_ptr<spill_file> spill(const std::vector<T>& run,
+                                      const std::filesystem::path& dir) {
+      auto file = std::make_unique<spill_file>(dir);
+      file->write(run.data(), run.size() * sizeof(T));
+      file->rewind();
+      return file;
+    }
+
+    /// Merges sorted runs, which it owns and so removes once done, with `memory` bytes
+    /// of read buffers between them.
+    template <class T, class Compare>
+    generator<T> merge_runs(std::vector<std::unique_ptr<spill_file>> runs, Compare comp,
+                            std::size_t memory) {
+      std::vector<run_reader<T>> readers;
+      for (auto& run : runs) readers.emplace_back(*run, memory / runs.size() / sizeof(T));
+      // A heap of the readers that aren't empty, with the smallest front at the top.
+      std::vector<std::size_t> heap;
+      auto later = [&](std::size_t a, std::size_t b) {
+        return comp(readers[b].front(), readers[a].front());
+      };
+      for (std::size_t i = 0; i < readers.size(); ++i) {
+        if (!readers[i].empty()) heap.push_back(i);
+      }
+      std::make_heap(heap.begin(), heap.end(), later);
+      while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        auto& reader = readers[heap.back()];
+        co_yield reader.front();
+        reader.pop();
+        if (reader.empty()) {
+          heap.pop_back();
+        } else {
+          std::push_heap(heap.begin(), heap.end(), later);
+        }
+      }
+    }
+  }  // namespace detail
+
+  /// Sorts `range` by `comp` using at most about `memory_budget` bytes, spilling to
+  /// temporary files in `tmpdir` (by default, the system's temporary directory), and
+  /// yields the elements in order as they are merged. Elements are spilled as raw
+  /// bytes, so they must be trivially copyable.
+  ///
+  /// The range is read in runs of half memory_budget bytes. Each run is sorted on
+  /// several threads, which merge their slices into the other half, and written to its
+  /// own file. If the whole range fits in one run, it is yielded straight from memory.
+  /// Otherwise the runs are merged, many at once, and the final merge is yielded as it
+  /// goes, so the output is never held in memory. If there are more runs than the
+  /// budget can give a read buffer each, groups of them are merged into longer runs
+  /// first. The files are removed as soon as they've been merged, or when the
+  /// generator is destroyed. If comp throws, even on another thread, the exception is
+  /// rethrown to the consumer.
+  template <class InputRange, class Compare>
+  auto sort_external(InputRange range, Compare comp, std::size_t memory_budget,
+                     std::filesystem::path tmpdir = {})
+      -> generator<ranges::range_value_t<InputRange>> {
+    using element_type = ranges::range_value_t<InputRange>;
+    static_assert(std::is_trivially_copyable<element_type>::value,
+                  "sort_external spills elements as raw bytes");
+    if (tmpdir.empty()) tmpdir = std::filesystem::temp_directory_path();
+    memory_budget = std::max(memory_budget, 2 * sizeof(element_type));
+
+    // Half the budget holds the run and the other half the slices it's merged into.
+    auto run_size = memory_budget / 2 / sizeof(element_type);
+    std::vector<element_type> run;
+    std::vector<element_type> scratch;
+    run.reserve(run_size);
+    scratch.reserve(run_size);
+    std::optional<thread_pool> pool;
+    std::vector<std::unique_ptr<detail::spill_file>> runs;
+    RANGES_FOR(auto&& x, range) {
+      run.push_back(std::forward<decltype(x)>(x));
+      if (run.size() == run_size) {
+        detail::parallel_sort(run, scratch, comp, pool);
+        runs.push_back(detail::spill(run, tmpdir));
+        run.clear();
+      }
+    }
+    detail::parallel_sort(run, scratch, comp, pool);
+    pool.reset();
+    scratch = std::vector<element_type>();
+    if (runs.empty()) {
+      co_yield elements_of(run);
+      co_return;
+    }
+    if (!run.empty()) runs.push_back(detail::spill(run, tmpdir));
+    // The buffers for merging take the run's place in the budget.
+    run = std::vector<element_type>();
+
+    auto fan_in = std::max<std::size_t>(memory_budget / detail::min_merge_buffer, 2);
+    while (runs.size() > fan_in) {
+      // Merge the oldest runs into one at the back, so that runs stay similar sizes.
+      std::vector<std::unique_ptr<detail::spill_file>> group(
+          std::make_move_iterator(runs.begin()),
+          std::make_move_iterator(runs.begin() + fan_in));
+      runs.erase(runs.begin(), runs.begin() + fan_in);
+      detail::spill_writer<element_type> merged(
+          tmpdir, memory_budget / 2 / sizeof(element_type));
+      RANGES_FOR(auto&& x, detail::merge_runs<element_type>(std::move(group), comp,
+                                                            memory_budget / 2)) {
+        merged.push(x);
+      }
+      runs.push_back(merged.finish());
+    }
+    RANGES_FOR(auto&& x, detail::merge_runs<element_type>(std::move(runs), comp,
+                                                          memory_budget)) {
+      co_yield x;
+    }
+  }
+}  // namespace toby
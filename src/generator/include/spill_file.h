@@ -0,0 +1,105 @@
+#pragma once
+
+#include "generator.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace toby {
+  namespace detail {
+    /// A temporary file, removed when it's destroyed, for spilling elements that don't
+    /// fit in memory. It is written from start to end, then rewound and read from start
+    /// to end.
+    class spill_file {
+     public:
+      /// Creates a new, uniquely named file in `dir`.
+      explicit spill_file(const std::filesystem::path& dir);
+      spill_file(const spill_file&) = delete;
+      spill_file& operator=(const spill_file&) = delete;
+      ~spill_file();
+
+      void write(const void* data, std::size_t bytes);
+      /// Finishes writing; reads start from the beginning of the file.
+      void rewind();
+      /// Reads up to `bytes`, returning how many were read: fewer only at the end.
+      std::size_t read(void* data, std::size_t bytes);
+
+      const std::filesystem::path& path() const { return m_path; }
+
+     private:
+      std::filesystem::path m_path;
+      std::FILE* m_file;
+    };
+
+    /// Reads the elements in a spill_file back through a fixed-size buffer.
+    template <class T>
+    class run_reader {
+     public:
+      run_reader(spill_file& file, std::size_t buffer_size)
+          : m_file(&file), m_buffer(std::max<std::size_t>(buffer_size, 1)) {
+        fill();
+      }
+
+      bool empty() const { return m_next == m_end; }
+      const T& front() const { return m_buffer[m_next]; }
+      void pop() {
+        if (++m_next == m_end) fill();
+      }
+
+     private:
+      void fill() {
+        m_next = 0;
+        m_end  = m_file->read(m_buffer.data(), m_buffer.size() * sizeof(T)) / sizeof(T);
+      }
+
+      spill_file* m_file;
+      std::vector<T> m_buffer;
+      std::size_t m_next = 0;
+      std::size_t m_end  = 0;
+    };
+
+    /// Writes elements to a spill_file through a fixed-size buffer.
+    template <class T>
+    class spill_writer {
+     public:
+      spill_writer(const std::filesystem::path& dir, std::size_t buffer_size)
+          : m_file(std::make_unique<spill_file>(dir)) {
+        m_buffer.reserve(std::max<std::size_t>(buffer_size, 1));
+      }
+
+      void push(const T& x) {
+        m_buffer.push_back(x);
+        if (m_buffer.size() == m_buffer.capacity()) flush();
+      }
+
+      /// Writes what's buffered and hands over the file, rewound for reading.
+      std::unique_ptr<spill_file> finish() {
+        flush();
+        m_file->rewind();
+        return std::move(m_file);
+      }
+
+     private:
+      void flush() {
+        m_file->write(m_buffer.data(), m_buffer.size() * sizeof(T));
+        m_buffer.clear();
+      }
+
+      std::unique_ptr<spill_file> m_file;
+      std::vector<T> m_buffer;
+    };
+
+    /// The elements in a spill_file, read through a buffer of `buffer_size` elements.
+    template <class T>
+    generator<T> read_spill(spill_file& file, std::size_t buffer_size) {
+      for (run_reader<T> reader(file, buffer_size); !reader.empty(); reader.pop()) {
+        co_yield reader.front();
+      }
+    }
+  }  // namespace detail
+}  // namespace toby
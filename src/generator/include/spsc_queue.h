@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace toby {
+  namespace detail {
+    /// The size of the cache lines that the queue's producer and consumer indices are
+    /// kept apart by.
+    constexpr std::size_t cache_line = 64;
+
+    /// Waiting for another thread without a lock to wait on: spins briefly, then yields
+    /// the core, then sleeps, so that a long wait doesn't burn a core.
+    class backoff {
+     public:
+      void pause() {
+        if (++m_waits < 64) return;
+        if (m_waits < 1024) {
+          std::this_thread::yield();
+        } else {
+          std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+      }
+
+     private:
+      unsigned m_waits = 0;
+    };
+  }  // namespace detail
+
+  /// A bounded, lock-free queue between exactly one producer thread and one consumer
+  /// thread. T must be default constructible and move assignable; batches such as
+  /// std::vector are the intended payload, so that a hand-off is paid for once per
+  /// batch.
+  ///
+  /// The blocking push and pop wait with detail::backoff. The producer calls close()
+  /// after its last push, and either side can cancel() to make both give up.
+  template <class T>
+  class spsc_queue {
+   public:
+    /// A queue of `capacity` elements (at least one). Its slots are rounded up to a
+    /// power of two so that indexing them is a mask, but no more than `capacity` are
+    /// ever full.
+    explicit spsc_queue(std::size_t capacity)
+        : m_capacity(std::max<std::size_t>(capacity, 1)), m_slots(round_up(m_capacity)) {}
+    spsc_queue(const spsc_queue&) = delete;
+    spsc_queue& operator=(const spsc_queue&) = delete;
+
+    std::size_t capacity() const { return m_capacity; }
+
+    /// Producer: moves `value` in if there's room. `value` is untouched on failure.
+    bool try_push(T&& value) {
+      auto tail = m_tail.load(std::memory_order_relaxed);
+      if (tail - m_cached_head == m_capacity) {
+        m_cached_head = m_head.load(std::memory_order_acquire);
+        if (tail - m_cached_head == m_capacity) return false;
+      }
+      m_slots[tail & (m_slots.size() - 1)] = std::move(value);
+      m_tail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    /// Consumer: moves the oldest element into `value` if there is one.
+    bool try_pop(T& value) {
+      auto head = m_head.load(std::memory_order_relaxed);
+      if (head == m_cached_tail) {
+        m_cached_tail = m_tail.load(std::memory_order_acquire);
+        if (head == m_cached_tail) return false;
+      }
+      value = std::move(m_slots[head & (m_slots.size() - 1)]);
+      m_head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    /// Producer: waits for room, then pushes. Returns false, leaving `value` untouched,
+    /// if the queue is cancelled first.
+    bool push(T&& value) {
+      detail::backoff wait;
+      while (!try_push(std::move(value))) {
+        if (cancelled()) return false;
+        wait.pause();
+      }
+      return true;
+    }
+
+    /// Consumer: waits for an element and pops it. Returns false once the queue is
+    /// closed and empty, or as soon as it is cancelled.
+    bool pop(T& value) {
+      detail::backoff wait;
+      for (;;) {
+        if (cancelled()) return false;
+        if (try_pop(value)) return true;
+        // Anything pushed before close() is visible once closed is.
+        if (m_closed.load(std::memory_order_acquire)) return try_pop(value);
+        wait.pause();
+      }
+    }
+
+    /// Producer: there will be no more pushes.
+    void close() { m_closed.store(true, std::memory_order_release); }
+
+    /// Either side: makes waiting pushes and pops, and all later ones, fail.
+    void cancel() { m_cancelled.store(true, std::memory_order_release); }
+    bool cancelled() const { return m_cancelled.load(std::memory_order_acquire); }
+
+   private:
+    static std::size_t round_up(std::size_t capacity) {
+      std::size_t size = 1;
+      while (size < capacity) size *= 2;
+      return size;
+    }
+
+    const std::size_t m_capacity;
+    std::vector<T> m_slots;
+    std::atomic<bool> m_closed{false};
+    std::atomic<bool> m_cancelled{false};
+    // Written by the consumer.
+    alignas(detail::cache_line) std::atomic<std::size_t> m_head{0};
+    std::size_t m_cached_tail = 0;
+    // Written by the producer.
+    alignas(detail::cache_line) std::atomic<std::size_t> m_tail{0};
+    std::size_t m_cached_head = 0;
+  };
+}  // namespace toby
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace toby {
+  /// A fixed set of worker threads taking tasks from one shared FIFO queue, for the
+  /// parallel generator adaptors.
+  class thread_pool {
+   public:
+    /// Starts `threads` workers (at least one).
+    explicit thread_pool(unsigned threads);
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+    /// Runs every task already submitted, then joins the workers.
+    ~thread_pool();
+
+    std::size_t size() const { return m_threads.size(); }
+
+    /// Queues a task to run on one of the workers. Tasks mustn't throw.
+    void submit(std::function<void()> task);
+
+   private:
+    void run();
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::function<void()>> m_tasks;
+    bool m_stopping = false;
+    std::vector<std::thread> m_threads;
+  };
+}  // namespace toby
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace toby {
+  /// Worker threads that each keep their own deque of tasks, for divide-and-conquer work
+  /// such as parallel_reduce. A task spawned on a worker goes on the back of that
+  /// worker's deque and the worker takes its next task from the back too, so it keeps
+  /// working on the most recently split (smallest, hottest) piece; an idle worker steals
+  /// from the front of another's deque, where the oldest and biggest pieces are.
+  class work_stealing_pool {
+   public:
+    /// Starts `threads` workers (at least one).
+    explicit work_stealing_pool(unsigned threads);
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+    /// Joins the workers. Mustn't be called while a run is in progress.
+    ~work_stealing_pool();
+
+    std::size_t size() const { return m_workers.size(); }
+
+    /// Runs `task` on the pool and waits for it and everything it spawns to finish.
+    /// If any of those tasks throws, the first exception is rethrown here, once they
+    /// have all finished. Only one run may be in progress at a time.
+    void run(std::function<void()> task);
+
+    /// Queues a task to be run as part of the current run. Must be called from a task.
+    void spawn(std::function<void()> task);
+
+   private:
+    struct worker {
+      std::mutex mutex;
+      std::deque<std::function<void()>> tasks;
+      std::thread thread;
+    };
+
+    void work(std::size_t index);
+    bool pop(std::size_t index, std::function<void()>& task);
+    void execute(std::function<void()>& task);
+
+    std::vector<std::unique_ptr<worker>> m_workers;
+    std::atomic<std::size_t> m_queued{0};   // tasks in any deque
+    std::atomic<std::size_t> m_pending{0};  // tasks spawned but not yet finished
+    std::mutex m_mutex;
+    std::condition_variable m_work_cv;
+    std::condition_variable m_done_cv;
+    std::exception_ptr m_error;
+    bool m_stopping = false;
+  };
+}  // namespace toby
@@ -0,0 +1,60 @@
+#include <coroutine_identity.h>
+
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+#if defined(__GNUC__) && !defined(_WIN32)
+#include <cxxabi.h>
+#include <dlfcn.h>
+#define TOBY_HAVE_DLADDR 1
+#endif
+
+namespace toby {
+  namespace {
+    struct name_table {
+      std::mutex mutex;
+      std::unordered_map<const void*, std::string> names;
+    };
+
+    name_table& names() {
+      static name_table table;
+      return table;
+    }
+  }  // namespace
+
+  void set_coroutine_name(const void* identity, std::string name) {
+    name_table& table = names();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    table.names[identity] = std::move(name);
+  }
+
+  std::string coroutine_name(const void* identity) {
+    {
+      name_table& table = names();
+      std::lock_guard<std::mutex> lock(table.mutex);
+      auto it = table.names.find(identity);
+      if (it != table.names.end()) return it->second;
+    }
+#if TOBY_HAVE_DLADDR
+    Dl_info info;
+    if (dladdr(identity, &info) && info.dli_sname) {
+      // The destroy function is the coroutine's own symbol with a suffix such as
+      // ".destroy".
+      std::string symbol = info.dli_sname;
+      symbol             = symbol.substr(0, symbol.find('.'));
+      int status         = 0;
+      char* demangled    = abi::__cxa_demangle(symbol.c_str(), nullptr, nullptr, &status);
+      if (status == 0 && demangled) {
+        symbol = demangled;
+      }
+      std::free(demangled);
+      return symbol;
+    }
+#endif
+    std::ostringstream os;
+    os << identity;
+    return os.str();
+  }
+}  // namespace toby
@@ -0,0 +1,105 @@
+#include <frame_registry.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <ostream>
+
+namespace toby {
+  frame_registry::frame_registry()
+      : m_handler([](const frame_stats& stats, std::size_t bytes) {
+          std::fprintf(stderr,
+                       "coroutine frame for %s is %zu bytes, over its budget of %zu\n",
+                       stats.name.c_str(), bytes, stats.budget);
+#ifndef NDEBUG
+          std::abort();
+#endif
+        }) {}
+
+  frame_registry& frame_registry::instance() {
+    static frame_registry registry;
+    return registry;
+  }
+
+  frame_stats& frame_registry::entry(const void* identity) {
+    auto it = m_entries.find(identity);
+    if (it == m_entries.end()) {
+      it = m_entries.emplace(identity, frame_stats{identity, {}, 0, 0, 0, 0}).first;
+    }
+    return it->second;
+  }
+
+  void frame_registry::record(const void* identity, std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    frame_stats& stats = entry(identity);
+    stats.min_bytes    = stats.frames == 0 ? bytes : std::min(stats.min_bytes, bytes);
+    stats.max_bytes    = std::max(stats.max_bytes, bytes);
+    ++stats.frames;
+  }
+
+  void frame_registry::check(const void* identity,
+                             std::size_t bytes,
+                             const frame_budget& budget) {
+    frame_stats over_budget;
+    budget_handler handler;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      frame_stats& stats = entry(identity);
+      stats.name         = budget.name;
+      stats.budget       = budget.max_bytes;
+      set_coroutine_name(identity, budget.name);
+      if (bytes <= budget.max_bytes) return;
+      over_budget = stats;
+      handler     = m_handler;
+    }
+    // Called without the lock held so that the handler may use the registry.
+    if (handler) handler(over_budget, bytes);
+  }
+
+  frame_registry::budget_handler frame_registry::set_budget_handler(
+      budget_handler handler) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::swap(m_handler, handler);
+    return handler;
+  }
+
+  std::vector<frame_stats> frame_registry::snapshot() const {
+    std::vector<frame_stats> result;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      for (const auto& e : m_entries) result.push_back(e.second);
+    }
+    for (auto& stats : result) {
+      if (stats.name.empty()) stats.name = coroutine_name(stats.identity);
+    }
+    std::sort(result.begin(), result.end(),
+              [](const frame_stats& a, const frame_stats& b) {
+                return a.max_bytes > b.max_bytes;
+              });
+    return result;
+  }
+
+  void frame_registry::dump(std::ostream& os) const {
+    os << std::setw(8) << "frames" << std::setw(10) << "min" << std::setw(10) << "max"
+       << std::setw(10) << "budget"
+       << "  coroutine\n";
+    for (const auto& stats : snapshot()) {
+      os << std::setw(8) << stats.frames << std::setw(10) << stats.min_bytes
+         << std::setw(10) << stats.max_bytes << std::setw(10);
+      if (stats.budget) {
+        os << stats.budget;
+      } else {
+        os << "-";
+      }
+      os << "  " << stats.name;
+      if (stats.budget && stats.max_bytes > stats.budget) os << " (OVER)";
+      os << "\n";
+    }
+  }
+
+  void frame_registry::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+  }
+}  // namespace toby
@@ -0,0 +1,128 @@
+#include <generator_stats.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+
+namespace toby {
+  namespace {
+    std::uint64_t now_ns() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+    }
+
+    /// Time spent in generators resumed from the coroutine currently running on this
+    /// thread, which is subtracted from its own time to give self_ns.
+    thread_local std::uint64_t child_ns = 0;
+
+    void write_json_string(std::ostream& os, const std::string& s) {
+      os << '"';
+      for (char c : s) {
+        if (c == '"' || c == '\\') {
+          os << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+          os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c)
+             << std::dec << std::setfill(' ');
+        } else {
+          os << c;
+        }
+      }
+      os << '"';
+    }
+  }  // namespace
+
+  generator_stats& generator_stats::instance() {
+    static generator_stats stats;
+    return stats;
+  }
+
+  generator_stats::entry& generator_stats::lookup(const void* identity) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& e = m_entries[identity];
+    if (!e) e.reset(new entry);
+    return *e;
+  }
+
+  std::vector<coroutine_counters> generator_stats::snapshot() const {
+    std::vector<coroutine_counters> result;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      for (const auto& kv : m_entries) {
+        const entry& e = *kv.second;
+        result.push_back({kv.first, {}, e.frames.load(std::memory_order_relaxed),
+                          e.resumes.load(std::memory_order_relaxed),
+                          e.yields.load(std::memory_order_relaxed),
+                          e.completions.load(std::memory_order_relaxed),
+                          e.total_ns.load(std::memory_order_relaxed),
+                          e.self_ns.load(std::memory_order_relaxed)});
+      }
+    }
+    for (auto& c : result) c.name = coroutine_name(c.identity);
+    std::sort(result.begin(), result.end(),
+              [](const coroutine_counters& a, const coroutine_counters& b) {
+                return a.self_ns > b.self_ns;
+              });
+    return result;
+  }
+
+  void generator_stats::dump_text(std::ostream& os) const {
+    os << std::setw(10) << "frames" << std::setw(12) << "resumes" << std::setw(12)
+       << "yields" << std::setw(10) << "done" << std::setw(14) << "total ns"
+       << std::setw(14) << "self ns"
+       << "  coroutine\n";
+    for (const auto& c : snapshot()) {
+      os << std::setw(10) << c.frames << std::setw(12) << c.resumes << std::setw(12)
+         << c.yields << std::setw(10) << c.completions << std::setw(14) << c.total_ns
+         << std::setw(14) << c.self_ns << "  " << c.name << "\n";
+    }
+  }
+
+  void generator_stats::dump_json(std::ostream& os) const {
+    os << "[";
+    const char* separator = "\n";
+    for (const auto& c : snapshot()) {
+      os << separator << "  {\"name\": ";
+      write_json_string(os, c.name);
+      os << ", \"frames\": " << c.frames << ", \"resumes\": " << c.resumes
+         << ", \"yields\": " << c.yields << ", \"completions\": " << c.completions
+         << ", \"total_ns\": " << c.total_ns << ", \"self_ns\": " << c.self_ns << "}";
+      separator = ",\n";
+    }
+    os << "\n]\n";
+  }
+
+  void generator_stats::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& kv : m_entries) {
+      entry& e = *kv.second;
+      e.frames.store(0, std::memory_order_relaxed);
+      e.resumes.store(0, std::memory_order_relaxed);
+      e.yields.store(0, std::memory_order_relaxed);
+      e.completions.store(0, std::memory_order_relaxed);
+      e.total_ns.store(0, std::memory_order_relaxed);
+      e.self_ns.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void counting_instrumentation::on_create(const void* frame) {
+    m_entry = &generator_stats::instance().lookup(coroutine_identity(frame));
+    m_entry->frames.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void counting_instrumentation::on_resume(const void*) {
+    m_entry->resumes.fetch_add(1, std::memory_order_relaxed);
+    m_outer_child_ns = child_ns;
+    child_ns         = 0;
+    m_resumed_at     = now_ns();
+  }
+
+  void counting_instrumentation::on_suspend(const void*) {
+    std::uint64_t elapsed = now_ns() - m_resumed_at;
+    m_entry->total_ns.fetch_add(elapsed, std::memory_order_relaxed);
+    m_entry->self_ns.fetch_add(elapsed - std::min(child_ns, elapsed),
+                               std::memory_order_relaxed);
+    child_ns = m_outer_child_ns + elapsed;
+  }
+}  // namespace toby
@@ -0,0 +1,205 @@
+#include <generator_trace.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+#include <unordered_map>
+
+namespace toby {
+  class trace_recorder::thread_buffer {
+   public:
+    thread_buffer(std::uint32_t thread, std::size_t capacity)
+        : m_thread(thread), m_events(capacity), m_mask(capacity - 1) {}
+
+    std::uint32_t thread() const { return m_thread; }
+    std::size_t capacity() const { return m_events.size(); }
+
+    // Called only by whoever holds the recorder's buffers mutex, once the producer has
+    // exited.
+    bool empty() const {
+      return m_head.load(std::memory_order_acquire) ==
+             m_tail.load(std::memory_order_relaxed);
+    }
+
+    // Called only by the owning thread.
+    bool push(const trace_event& event) {
+      auto head = m_head.load(std::memory_order_relaxed);
+      if (head - m_tail.load(std::memory_order_acquire) == m_events.size()) {
+        return false;
+      }
+      m_events[head & m_mask] = event;
+      m_head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Called only by whoever holds the recorder's buffers mutex.
+    void pop_all(std::vector<trace_event>& out) {
+      auto tail = m_tail.load(std::memory_order_relaxed);
+      auto head = m_head.load(std::memory_order_acquire);
+      for (; tail != head; ++tail) out.push_back(m_events[tail & m_mask]);
+      m_tail.store(tail, std::memory_order_release);
+    }
+
+   private:
+    const std::uint32_t m_thread;
+    std::vector<trace_event> m_events;
+    const std::size_t m_mask;
+    // Kept on separate cache lines so the producer and consumer don't share one.
+    alignas(64) std::atomic<std::size_t> m_head{0};
+    alignas(64) std::atomic<std::size_t> m_tail{0};
+  };
+
+  trace_recorder::trace_recorder() : m_capacity(16384) {}
+
+  trace_recorder::~trace_recorder() { stop_flushing(); }
+
+  trace_recorder& trace_recorder::instance() {
+    static trace_recorder recorder;
+    return recorder;
+  }
+
+  /// Returns a thread's buffer to the recorder's free list when the thread exits.
+  class trace_recorder::buffer_owner {
+   public:
+    ~buffer_owner() {
+      if (!buffer) return;
+      std::lock_guard<std::mutex> lock(recorder->m_buffers_mutex);
+      recorder->m_free.push_back(buffer);
+    }
+
+    trace_recorder* recorder = nullptr;
+    thread_buffer* buffer    = nullptr;
+  };
+
+  trace_recorder::thread_buffer* trace_recorder::local_buffer(bool attach) {
+    thread_local buffer_owner owner;
+    if (owner.buffer || !attach) return owner.buffer;
+    // Buffers are owned by the recorder so that events recorded by a thread that has
+    // since exited can still be written out. Such a buffer is reused once drained, so
+    // that threads coming and going don't grow the recorder without bound.
+    std::lock_guard<std::mutex> lock(m_buffers_mutex);
+    auto reusable = std::find_if(m_free.begin(), m_free.end(), [&](thread_buffer* b) {
+      return b->capacity() == m_capacity && b->empty();
+    });
+    if (reusable != m_free.end()) {
+      owner.buffer = *reusable;
+      m_free.erase(reusable);
+    } else {
+      m_free.reserve(m_buffers.size() + 1);
+      m_buffers.emplace_back(new thread_buffer(
+          static_cast<std::uint32_t>(m_buffers.size() + 1), m_capacity));
+      owner.buffer = m_buffers.back().get();
+    }
+    owner.recorder = this;
+    return owner.buffer;
+  }
+
+  void trace_recorder::attach_thread() { local_buffer(true); }
+
+  void trace_recorder::record(trace_event event) noexcept {
+    thread_buffer* buffer = local_buffer(false);
+    if (!buffer) {
+      try {
+        buffer = local_buffer(true);
+      } catch (...) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    }
+    event.thread = buffer->thread();
+    if (!buffer->push(event)) m_dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void trace_recorder::set_buffer_capacity(std::size_t events) {
+    std::size_t capacity = 1;
+    while (capacity < events) capacity *= 2;
+    std::lock_guard<std::mutex> lock(m_buffers_mutex);
+    m_capacity = capacity;
+  }
+
+  std::vector<trace_event> trace_recorder::drain() {
+    std::vector<trace_event> events;
+    std::lock_guard<std::mutex> lock(m_buffers_mutex);
+    for (auto& buffer : m_buffers) buffer->pop_all(events);
+    return events;
+  }
+
+  void trace_recorder::write_events(std::ostream& os,
+                                    const std::vector<trace_event>& events) {
+    std::unordered_map<const void*, std::string> names;
+    char line[256];
+    for (const auto& e : events) {
+      auto name = names.find(e.identity);
+      if (name == names.end()) {
+        name = names.emplace(e.identity, coroutine_name(e.identity)).first;
+      }
+      os << (m_first_event ? "\n" : ",\n") << "{\"name\": \"";
+      // Coroutine names are identifiers, addresses or demangled C++ names, none of
+      // which need escaping beyond quotes and backslashes.
+      for (char c : name->second) {
+        if (c == '"' || c == '\\') os << '\\';
+        os << c;
+      }
+      if (e.complete) {
+        std::snprintf(line, sizeof(line),
+                      "\", \"cat\": \"generator\", \"ph\": \"i\", \"s\": \"t\", "
+                      "\"ts\": %.3f, \"pid\": 1, \"tid\": %u, "
+                      "\"args\": {\"frame\": \"%p\", \"event\": \"complete\"}}",
+                      e.begin_ns / 1000.0, e.thread, e.frame);
+      } else {
+        std::snprintf(line, sizeof(line),
+                      "\", \"cat\": \"generator\", \"ph\": \"X\", \"ts\": %.3f, "
+                      "\"dur\": %.3f, \"pid\": 1, \"tid\": %u, "
+                      "\"args\": {\"frame\": \"%p\"}}",
+                      e.begin_ns / 1000.0, (e.end_ns - e.begin_ns) / 1000.0, e.thread,
+                      e.frame);
+      }
+      os << line;
+      m_first_event = false;
+    }
+  }
+
+  void trace_recorder::write_chrome_json(std::ostream& os) {
+    std::lock_guard<std::mutex> lock(m_flush_mutex);
+    auto events = drain();
+    std::sort(events.begin(), events.end(),
+              [](const trace_event& a, const trace_event& b) {
+                return a.begin_ns < b.begin_ns;
+              });
+    os << "{\"traceEvents\": [";
+    m_first_event = true;
+    write_events(os, events);
+    os << "\n]}\n";
+  }
+
+  void trace_recorder::start_flushing(const std::string& path,
+                                      std::chrono::milliseconds period) {
+    stop_flushing();
+    std::lock_guard<std::mutex> lock(m_flush_mutex);
+    m_file.open(path);
+    m_file << "{\"traceEvents\": [";
+    m_first_event = true;
+    m_flushing    = true;
+    m_flusher     = std::thread([this, period] {
+      std::unique_lock<std::mutex> lock(m_flush_mutex);
+      while (m_flushing) {
+        m_flush_cv.wait_for(lock, period);
+        write_events(m_file, drain());
+      }
+    });
+  }
+
+  void trace_recorder::stop_flushing() {
+    {
+      std::lock_guard<std::mutex> lock(m_flush_mutex);
+      if (!m_flushing) return;
+      m_flushing = false;
+    }
+    m_flush_cv.notify_all();
+    m_flusher.join();
+    std::lock_guard<std::mutex> lock(m_flush_mutex);
+    write_events(m_file, drain());
+    m_file << "\n]}\n";
+    m_file.close();
+  }
+}  // namespace toby
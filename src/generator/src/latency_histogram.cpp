@@ -0,0 +1,141 @@
+#include <latency_histogram.h>
+
+#include <algorithm>
+#include <ostream>
+#include <utility>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace toby {
+  namespace {
+    int highest_bit(std::uint64_t value) {
+#if defined(_MSC_VER)
+      unsigned long index;
+      _BitScanReverse64(&index, value);
+      return static_cast<int>(index);
+#else
+      return 63 - __builtin_clzll(value);
+#endif
+    }
+
+    std::atomic<std::uint64_t> next_histogram_id{0};
+  }  // namespace
+
+  constexpr int histogram_snapshot::sub_bucket_bits;
+  constexpr int histogram_snapshot::sub_bucket_count;
+  constexpr int histogram_snapshot::bucket_count;
+
+  int histogram_snapshot::bucket_index(std::uint64_t value) {
+    if (value < sub_bucket_count) return static_cast<int>(value);
+    int exponent  = highest_bit(value);
+    int shift     = exponent - sub_bucket_bits;
+    auto mantissa = static_cast<int>(value >> shift);  // in [32, 64)
+    return (shift + 1) * sub_bucket_count + mantissa - sub_bucket_count;
+  }
+
+  std::uint64_t histogram_snapshot::bucket_lowest(int index) {
+    if (index < sub_bucket_count) return static_cast<std::uint64_t>(index);
+    int shift = index / sub_bucket_count - 1;
+    auto mantissa =
+        static_cast<std::uint64_t>(index % sub_bucket_count + sub_bucket_count);
+    return mantissa << shift;
+  }
+
+  std::uint64_t histogram_snapshot::bucket_highest(int index) {
+    if (index < sub_bucket_count) return static_cast<std::uint64_t>(index);
+    int shift = index / sub_bucket_count - 1;
+    return bucket_lowest(index) + ((std::uint64_t(1) << shift) - 1);
+  }
+
+  void histogram_snapshot::merge(const histogram_snapshot& other) {
+    for (int i = 0; i < bucket_count; ++i) m_counts[i] += other.m_counts[i];
+  }
+
+  std::uint64_t histogram_snapshot::count() const {
+    std::uint64_t total = 0;
+    for (auto c : m_counts) total += c;
+    return total;
+  }
+
+  std::uint64_t histogram_snapshot::min() const {
+    for (int i = 0; i < bucket_count; ++i) {
+      if (m_counts[i]) return bucket_lowest(i);
+    }
+    return 0;
+  }
+
+  std::uint64_t histogram_snapshot::max() const {
+    for (int i = bucket_count - 1; i >= 0; --i) {
+      if (m_counts[i]) return bucket_highest(i);
+    }
+    return 0;
+  }
+
+  double histogram_snapshot::mean() const {
+    double total    = 0;
+    std::uint64_t n = 0;
+    for (int i = 0; i < bucket_count; ++i) {
+      if (!m_counts[i]) continue;
+      // Use the middle of each bucket.
+      total += m_counts[i] * (bucket_lowest(i) / 2.0 + bucket_highest(i) / 2.0);
+      n += m_counts[i];
+    }
+    return n ? total / n : 0;
+  }
+
+  std::uint64_t histogram_snapshot::value_at_percentile(double percentile) const {
+    std::uint64_t total = count();
+    if (total == 0) return 0;
+    auto target        = static_cast<std::uint64_t>(percentile / 100.0 * total + 0.5);
+    target             = std::max<std::uint64_t>(1, std::min(target, total));
+    std::uint64_t seen = 0;
+    for (int i = 0; i < bucket_count; ++i) {
+      seen += m_counts[i];
+      if (seen >= target) return bucket_highest(i);
+    }
+    return max();
+  }
+
+  void histogram_snapshot::write_summary(std::ostream& os) const {
+    os << "count=" << count() << " mean=" << mean();
+    for (double p : {50.0, 90.0, 99.0, 99.9, 99.99}) {
+      os << " p" << p << "=" << value_at_percentile(p);
+    }
+    os << " max=" << max();
+  }
+
+  latency_histogram::latency_histogram() : m_id(next_histogram_id++) {}
+
+  latency_histogram::~latency_histogram() {}
+
+  std::atomic<std::uint64_t>* latency_histogram::local_shard() {
+    // Identified by id rather than address so that a histogram allocated where a
+    // destroyed one used to be doesn't pick up its shards.
+    thread_local std::vector<std::pair<std::uint64_t, shard*>> cache;
+    for (const auto& entry : cache) {
+      if (entry.first == m_id) return entry.second->counts;
+    }
+    // Forget the histogram looked up longest ago, which has probably been destroyed.
+    // If it hasn't, the thread finds its shard again in m_shards.
+    if (cache.size() >= 64) cache.erase(cache.begin());
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& s = m_shards[std::this_thread::get_id()];
+    if (!s) s.reset(new shard());
+    cache.emplace_back(m_id, s.get());
+    return s->counts;
+  }
+
+  histogram_snapshot latency_histogram::snapshot() const {
+    histogram_snapshot result;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& thread_shard : m_shards) {
+      const auto& counts = thread_shard.second->counts;
+      for (int i = 0; i < histogram_snapshot::bucket_count; ++i) {
+        if (auto c = counts[i].load(std::memory_order_relaxed)) result.add(i, c);
+      }
+    }
+    return result;
+  }
+}  // namespace toby
@@ -0,0 +1,72 @@
+#include <pipelined.h>
+
+#include <iomanip>
+#include <ostream>
+
+namespace toby {
+  double stage_stats::utilisation() const {
+    if (seconds <= 0) return 0;
+    return 1 - (input_wait + output_wait) / seconds;
+  }
+
+  std::size_t pipeline_stats::bottleneck() const {
+    std::size_t busiest = 0;
+    for (std::size_t i = 1; i < stages.size(); ++i) {
+      if (stages[i].utilisation() > stages[busiest].utilisation()) busiest = i;
+    }
+    return busiest;
+  }
+
+  void pipeline_stats::dump_text(std::ostream& os) const {
+    os << std::setw(8) << "stage" << std::setw(14) << "elements" << std::setw(12)
+       << "seconds" << std::setw(12) << "in wait" << std::setw(12) << "out wait"
+       << std::setw(8) << "busy"
+       << "\n";
+    for (std::size_t i = 0; i < stages.size(); ++i) {
+      const auto& s    = stages[i];
+      const char* name = i == 0 ? "source" : i + 1 == stages.size() ? "sink" : "";
+      os << std::setw(8);
+      if (*name) {
+        os << name;
+      } else {
+        os << i;
+      }
+      os << std::setw(14) << s.elements << std::fixed << std::setprecision(3)
+         << std::setw(12) << s.seconds << std::setw(12) << s.input_wait << std::setw(12)
+         << s.output_wait << std::setw(7) << std::setprecision(0)
+         << 100 * s.utilisation() << "%" << (i == bottleneck() ? "  <- bottleneck" : "")
+         << "\n";
+    }
+    os << std::defaultfloat;
+  }
+
+  namespace detail {
+    pipeline_run::~pipeline_run() {
+      cancel();
+      join();
+    }
+
+    void pipeline_run::fail(std::size_t stage, std::exception_ptr error) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_error) m_error = error;
+      for (std::size_t i = 0; i < stage; ++i) m_cancel[i]();
+    }
+
+    void pipeline_run::finish(pipeline_stats* stats) {
+      join();
+      if (stats) stats->stages = m_stats;
+      if (m_error) std::rethrow_exception(m_error);
+    }
+
+    void pipeline_run::cancel() {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      for (auto& cancel_channel : m_cancel) cancel_channel();
+    }
+
+    void pipeline_run::join() {
+      for (auto& thread : m_threads) {
+        if (thread.joinable()) thread.join();
+      }
+    }
+  }  // namespace detail
+}  // namespace toby
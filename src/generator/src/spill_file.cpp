@@ -0,0 +1,56 @@
+#include <spill_file.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+namespace toby {
+  namespace detail {
+    spill_file::spill_file(const std::filesystem::path& dir) : m_file(nullptr) {
+      static std::atomic<unsigned> counter{0};
+      auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+      for (int attempt = 0; !m_file && attempt < 16; ++attempt) {
+        m_path = dir / ("toby-spill-" + std::to_string(stamp) + "-" +
+                        std::to_string(counter.fetch_add(1)) + ".run");
+        // "x": fail rather than reuse a file that already exists.
+        m_file = std::fopen(m_path.string().c_str(), "w+bx");
+      }
+      if (!m_file) {
+        throw std::system_error(errno, std::generic_category(),
+                                "spill_file: can't create " + m_path.string());
+      }
+    }
+
+    spill_file::~spill_file() {
+      std::fclose(m_file);
+      std::error_code ignored;
+      std::filesystem::remove(m_path, ignored);
+    }
+
+    void spill_file::write(const void* data, std::size_t bytes) {
+      if (bytes && std::fwrite(data, 1, bytes, m_file) != bytes) {
+        throw std::system_error(errno, std::generic_category(),
+                                "spill_file: can't write " + m_path.string());
+      }
+    }
+
+    void spill_file::rewind() {
+      if (std::fflush(m_file) != 0 || std::fseek(m_file, 0, SEEK_SET) != 0) {
+        throw std::system_error(errno, std::generic_category(),
+                                "spill_file: can't rewind " + m_path.string());
+      }
+    }
+
+    std::size_t spill_file::read(void* data, std::size_t bytes) {
+      std::size_t read = std::fread(data, 1, bytes, m_file);
+      if (read < bytes && std::ferror(m_file)) {
+        throw std::system_error(errno, std::generic_category(),
+                                "spill_file: can't read " + m_path.string());
+      }
+      return read;
+    }
+  }  // namespace detail
+}  // namespace toby
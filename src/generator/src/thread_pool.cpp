@@ -0,0 +1,42 @@
+#include <thread_pool.h>
+
+#include <algorithm>
+
+namespace toby {
+  thread_pool::thread_pool(unsigned threads) {
+    threads = std::max(threads, 1u);
+    m_threads.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i) m_threads.emplace_back([this] { run(); });
+  }
+
+  thread_pool::~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_cv.notify_all();
+    for (auto& thread : m_threads) thread.join();
+  }
+
+  void thread_pool::submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_tasks.push_back(std::move(task));
+    }
+    m_cv.notify_one();
+  }
+
+  void thread_pool::run() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+        if (m_tasks.empty()) return;
+        task = std::move(m_tasks.front());
+        m_tasks.pop_front();
+      }
+      task();
+    }
+  }
+}  // namespace toby
@@ -0,0 +1,113 @@
+#include <work_stealing_pool.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace toby {
+  namespace {
+    // The pool and worker the current thread belongs to, if it's a worker.
+    thread_local const work_stealing_pool* current_pool = nullptr;
+    thread_local std::size_t current_worker             = 0;
+  }  // namespace
+
+  work_stealing_pool::work_stealing_pool(unsigned threads) {
+    threads = std::max(threads, 1u);
+    m_workers.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i) {
+      m_workers.push_back(std::make_unique<worker>());
+    }
+    // Only start the workers once they are all there to steal from.
+    for (unsigned i = 0; i < threads; ++i) {
+      m_workers[i]->thread = std::thread([this, i] { work(i); });
+    }
+  }
+
+  work_stealing_pool::~work_stealing_pool() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_work_cv.notify_all();
+    for (auto& w : m_workers) w->thread.join();
+  }
+
+  void work_stealing_pool::run(std::function<void()> task) {
+    m_error = nullptr;
+    spawn(std::move(task));
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_cv.wait(lock, [this] { return m_pending.load() == 0; });
+    if (m_error) std::rethrow_exception(std::exchange(m_error, nullptr));
+  }
+
+  void work_stealing_pool::spawn(std::function<void()> task) {
+    // Tasks spawned from outside the pool go to the first worker, to be stolen from
+    // there.
+    auto& w = *m_workers[current_pool == this ? current_worker : 0];
+    m_pending.fetch_add(1);
+    {
+      std::lock_guard<std::mutex> lock(w.mutex);
+      w.tasks.push_back(std::move(task));
+      m_queued.fetch_add(1);
+    }
+    {
+      // Taking the lock orders this with a worker checking m_queued before it sleeps.
+      std::lock_guard<std::mutex> lock(m_mutex);
+    }
+    m_work_cv.notify_one();
+  }
+
+  bool work_stealing_pool::pop(std::size_t index, std::function<void()>& task) {
+    {
+      auto& own = *m_workers[index];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (!own.tasks.empty()) {
+        task = std::move(own.tasks.back());
+        own.tasks.pop_back();
+        m_queued.fetch_sub(1);
+        return true;
+      }
+    }
+    for (std::size_t i = 1; i < m_workers.size(); ++i) {
+      auto& victim = *m_workers[(index + i) % m_workers.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.tasks.empty()) {
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        m_queued.fetch_sub(1);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void work_stealing_pool::execute(std::function<void()>& task) {
+    try {
+      task();
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_error) m_error = std::current_exception();
+    }
+    task = nullptr;
+    if (m_pending.fetch_sub(1) == 1) {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+      }
+      m_done_cv.notify_all();
+    }
+  }
+
+  void work_stealing_pool::work(std::size_t index) {
+    current_pool   = this;
+    current_worker = index;
+    std::function<void()> task;
+    for (;;) {
+      if (pop(index, task)) {
+        execute(task);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_work_cv.wait(lock, [this] { return m_stopping || m_queued.load() != 0; });
+      if (m_stopping) return;
+    }
+  }
+}  // namespace toby
@@ -5,7 +5,9 @@
 #include <range/v3/all.hpp>
 #include "doctest.h"
 
+#include <array>
 #include <memory>
+#include <vector>
 
 using toby::generator;
 
@@ -69,6 +71,135 @@ TEST_CASE("move-only type") {
   CHECK(i == g.end());
 }
 
+// Has neither a default constructor nor assignment, and counts its instances.
+struct tracked {
+  static int live;
+  static int constructed;
+
+  explicit tracked(int v) : value(v) {
+    ++live;
+    ++constructed;
+  }
+  tracked(int a, int b) : tracked(a * b) {}
+  tracked(const tracked& other) : tracked(other.value) {}
+  tracked& operator=(const tracked&) = delete;
+  ~tracked() { --live; }
+
+  int value;
+};
+int tracked::live        = 0;
+int tracked::constructed = 0;
+
+generator<tracked> tracked_values() {
+  tracked local(1);
+  co_yield local;
+  co_yield tracked(2);
+  co_yield toby::emplace(3, 4);
+}
+
+TEST_CASE("element type without a default constructor") {
+  tracked::live = 0;
+  {
+    auto g = tracked_values();
+    auto i = g.begin();
+    CHECK((*i).value == 1);
+    ++i;
+    CHECK((*i).value == 2);
+    int constructed = tracked::constructed;
+    ++i;
+    CHECK((*i).value == 12);
+    SUBCASE("emplace constructs the element in place") {
+      CHECK(tracked::constructed == constructed + 1);
+    }
+    ++i;
+    CHECK(i == g.end());
+    SUBCASE("the last element lives until the generator is destroyed") {
+      CHECK(tracked::live == 1);
+    }
+  }
+  CHECK(tracked::live == 0);
+}
+
+generator<std::unique_ptr<int>> emplaced_move_only() {
+  co_yield toby::emplace(new int(5));
+  co_yield toby::emplace();
+}
+
+TEST_CASE("emplace a move-only type") {
+  auto g = emplaced_move_only();
+  auto i = g.begin();
+  CHECK(**i == 5);
+  ++i;
+  CHECK(*i == nullptr);
+}
+
+std::vector<int> ten_eleven() { return {10, 11}; }
+
+generator<int> with_elements_of(std::vector<int>& v) {
+  co_yield -1;
+  co_yield toby::elements_of(v);
+  co_yield toby::elements_of(std::vector<int>());
+  co_yield toby::elements_of(ten_eleven());
+  std::array<int, 1> a = {20};
+  co_yield toby::elements_of(a);
+  co_yield -2;
+}
+
+TEST_CASE("elements_of") {
+  std::vector<int> v = {1, 2, 3};
+  std::vector<int> out;
+  auto g = with_elements_of(v);
+  for (auto i = g.begin(); i != g.end(); ++i) out.push_back(*i);
+  CHECK(out == std::vector<int>({-1, 1, 2, 3, 10, 11, 20, -2}));
+
+  SUBCASE("the consumer sees the range's own elements") {
+    auto h = with_elements_of(v);
+    auto i = h.begin();
+    ++i;
+    CHECK(&*i == &v[0]);
+    ++i;
+    CHECK(&*i == &v[1]);
+  }
+}
+
+generator<std::unique_ptr<int>> move_only_elements_of() {
+  std::vector<std::unique_ptr<int>> v;
+  v.push_back(std::make_unique<int>(1));
+  v.push_back(std::make_unique<int>(2));
+  co_yield toby::elements_of(v);
+  co_yield std::make_unique<int>(3);
+}
+
+TEST_CASE("elements_of a move-only type") {
+  auto g = move_only_elements_of();
+  std::vector<int> out;
+  for (auto i = g.begin(); i != g.end(); ++i) {
+    auto p = std::move(*i);
+    out.push_back(*p);
+  }
+  CHECK(out == std::vector<int>({1, 2, 3}));
+}
+
+TEST_CASE("destroying a generator part way through elements_of") {
+  tracked::live = 0;
+  {
+    std::vector<tracked> v;
+    v.reserve(3);
+    for (int i = 0; i < 3; ++i) v.emplace_back(i);
+    {
+      auto g = [](std::vector<tracked>& v) -> generator<tracked> {
+        co_yield tracked(-1);
+        co_yield toby::elements_of(v);
+      }(v);
+      auto i = g.begin();
+      ++i;
+      CHECK((*i).value == 0);
+    }
+    CHECK(tracked::live == 3);
+  }
+  CHECK(tracked::live == 0);
+}
+
 TEST_CASE("move iterator") {
 // these tests fail because std::move_iterator::operator++(int) is WRONG for input
 // iterators (see http://open-std.org/JTC1/SC22/WG21/docs/papers/2017/p0541r0.html)
@@ -122,3 +253,255 @@ TEST_CASE("infinite generator") {
     CHECK(v == std::vector<int>({0, 1, 2, 3, 4}));
   }
 }
+
+#if defined(__cpp_lib_ranges)
+TEST_CASE("std::ranges") {
+  using iterator = decltype(std::declval<generator<int>&>().begin());
+  static_assert(std::input_iterator<iterator>);
+  static_assert(std::sentinel_for<toby::generator_sentinel, iterator>);
+  static_assert(std::ranges::input_range<generator<int>>);
+  static_assert(std::ranges::view<generator<int>>);
+  static_assert(std::same_as<std::ranges::sentinel_t<generator<int>>,
+                             toby::generator_sentinel>);
+
+  SUBCASE("filter and take") {
+    std::vector<int> v;
+    for (int i : infinite() | std::views::filter([](int x) { return x % 3 == 0; }) |
+                     std::views::take(4)) {
+      v.push_back(i);
+    }
+    CHECK(v == std::vector<int>({0, 3, 6, 9}));
+  }
+  SUBCASE("copies of a view share the coroutine") {
+    auto g = upto(5);
+    auto h = g;
+    auto i = g.begin();
+    ++i;
+    CHECK(*h.begin() == 2);
+  }
+#if defined(__cpp_lib_ranges_to_container)
+  SUBCASE("ranges::to") {
+    CHECK((upto(3) | std::ranges::to<std::vector>()) == std::vector<int>({0, 1, 2}));
+  }
+#endif
+}
+#endif
+
+#if TOBY_GENERATOR_FRAME_REGISTRY
+
+#include <sstream>
+
+generator<int> within_budget() {
+  co_yield toby::frame_budget{"within_budget", 4096};
+  co_yield 1;
+}
+
+generator<int> over_budget() {
+  co_yield toby::frame_budget{"over_budget", 64};
+  int buffer[256] = {};
+  for (int& x : buffer) co_yield x;
+}
+
+TEST_CASE("frame registry") {
+  auto find = [](const char* name) {
+    for (auto& stats : toby::frame_registry::instance().snapshot()) {
+      if (stats.name == name) return stats;
+    }
+    return toby::frame_stats{};
+  };
+
+  std::vector<std::size_t> overruns;
+  auto previous = toby::frame_registry::instance().set_budget_handler(
+      [&](const toby::frame_stats&, std::size_t bytes) { overruns.push_back(bytes); });
+
+  SUBCASE("frames are recorded when they are allocated") {
+    auto g = within_budget();
+    // Consumed, so that a frame whose allocation is elided can't pick it up.
+    CHECK(toby::detail::last_frame_size() == 0);
+    g.begin();
+    auto stats = find("within_budget");
+    CHECK(stats.frames >= 1);
+    CHECK(stats.min_bytes > 0);
+    CHECK(stats.min_bytes <= stats.max_bytes);
+    CHECK(stats.budget == 4096);
+    CHECK(overruns.empty());
+  }
+
+  SUBCASE("yielding a budget doesn't produce an element") {
+    auto g = within_budget();
+    auto i = g.begin();
+    REQUIRE(i != g.end());
+    CHECK(*i == 1);
+    ++i;
+    CHECK(i == g.end());
+  }
+
+  SUBCASE("frames over budget are reported") {
+    auto g = over_budget();
+    auto i = g.begin();
+    REQUIRE(overruns.size() == 1);
+    CHECK(overruns[0] > 256 * sizeof(int));
+    CHECK(*i == 0);
+  }
+
+  SUBCASE("dump lists named coroutines") {
+    auto g = over_budget();
+    g.begin();
+    std::ostringstream os;
+    toby::frame_registry::instance().dump(os);
+    CHECK(os.str().find("over_budget") != std::string::npos);
+    CHECK(os.str().find("(OVER)") != std::string::npos);
+  }
+
+  toby::frame_registry::instance().set_budget_handler(previous);
+}
+
+#endif
+
+#include <generator_stats.h>
+
+#include <algorithm>
+#include <sstream>
+
+using counted = generator<int, int, toby::counting_instrumentation>;
+
+counted counted_upto(int n) {
+  for (int i = 0; i < n; ++i) co_yield i;
+}
+
+counted counted_evens(int n) {
+  for (int i : counted_upto(n)) {
+    if (i % 2 == 0) co_yield i;
+  }
+}
+
+/// Names the coroutine that `make` creates a frame of, so that its counters can be
+/// found: it's the one whose frame count changes.
+template <class Make>
+void name_counted(const char* name, Make make) {
+  auto before = toby::generator_stats::instance().snapshot();
+  auto g      = make();
+  for (auto& c : toby::generator_stats::instance().snapshot()) {
+    auto was = std::find_if(before.begin(), before.end(), [&](const auto& b) {
+      return b.identity == c.identity;
+    });
+    if (was == before.end() || was->frames != c.frames) {
+      toby::set_coroutine_name(c.identity, name);
+    }
+  }
+}
+
+TEST_CASE("counting instrumentation") {
+  auto find = [](const char* name) {
+    for (auto& c : toby::generator_stats::instance().snapshot()) {
+      if (c.name == name) return c;
+    }
+    return toby::coroutine_counters{};
+  };
+  name_counted("counted_upto", [] { return counted_upto(0); });
+  name_counted("counted_evens", [] { return counted_evens(0); });
+  toby::generator_stats::instance().reset();
+
+  SUBCASE("resumes, yields and completions are counted") {
+    for (int run = 0; run < 2; ++run) {
+      auto g = counted_upto(3);
+      for (auto i = g.begin(); i != g.end(); ++i) {
+      }
+    }
+    auto c = find("counted_upto");
+    CHECK(c.frames == 2);
+    CHECK(c.resumes == 8);
+    CHECK(c.yields == 6);
+    CHECK(c.completions == 2);
+    CHECK(c.self_ns <= c.total_ns);
+  }
+
+  SUBCASE("self time excludes nested generators") {
+    auto g = counted_evens(1000);
+    for (auto i = g.begin(); i != g.end(); ++i) {
+    }
+    auto outer = find("counted_evens");
+    auto inner = find("counted_upto");
+    CHECK(outer.yields == 500);
+    CHECK(inner.yields == 1000);
+    CHECK(inner.resumes == 1001);
+    CHECK(outer.total_ns >= inner.total_ns);
+    CHECK(outer.self_ns <= outer.total_ns - inner.total_ns);
+  }
+
+  SUBCASE("dumps") {
+    auto g = counted_upto(1);
+    g.begin();
+    std::ostringstream text, json;
+    toby::generator_stats::instance().dump_text(text);
+    toby::generator_stats::instance().dump_json(json);
+    CHECK(text.str().find("counted_upto") != std::string::npos);
+    CHECK(json.str().find("\"name\": \"counted_upto\"") != std::string::npos);
+  }
+}
+
+#include <generator_trace.h>
+
+#include <thread>
+
+using traced = generator<int, int, toby::trace_instrumentation>;
+
+traced traced_upto(int n) {
+  for (int i = 0; i < n; ++i) co_yield i;
+}
+
+TEST_CASE("trace instrumentation") {
+  auto count = [](const std::string& s, const std::string& what) {
+    std::size_t n = 0;
+    for (auto pos = s.find(what); pos != std::string::npos; pos = s.find(what, pos + 1)) {
+      ++n;
+    }
+    return n;
+  };
+  auto& recorder = toby::trace_recorder::instance();
+  std::ostringstream discard;
+  recorder.write_chrome_json(discard);
+
+  SUBCASE("each resume is a complete event") {
+    auto g = traced_upto(3);
+    for (auto i = g.begin(); i != g.end(); ++i) {
+    }
+    std::ostringstream os;
+    recorder.write_chrome_json(os);
+    CHECK(os.str().find("{\"traceEvents\": [") == 0);
+    CHECK(count(os.str(), "\"ph\": \"X\"") == 4);
+    CHECK(count(os.str(), "\"event\": \"complete\"") == 1);
+  }
+
+  SUBCASE("full buffers drop events") {
+    auto dropped_before = recorder.dropped();
+    recorder.set_buffer_capacity(8);
+    std::thread([] {
+      auto g = traced_upto(100);
+      for (auto i = g.begin(); i != g.end(); ++i) {
+      }
+    }).join();
+    recorder.set_buffer_capacity(16384);
+    std::ostringstream os;
+    recorder.write_chrome_json(os);
+    CHECK(count(os.str(), "\"tid\"") == 8);
+    CHECK(recorder.dropped() - dropped_before == 102 - 8);
+  }
+
+  SUBCASE("exited threads' buffers are reused once drained") {
+    auto traced_thread = [&] {
+      std::thread([] {
+        auto g = traced_upto(1);
+        for (auto i = g.begin(); i != g.end(); ++i) {
+        }
+      }).join();
+      std::ostringstream os;
+      recorder.write_chrome_json(os);
+      auto tid = os.str().find("\"tid\"");
+      REQUIRE(tid != std::string::npos);
+      return os.str().substr(tid, os.str().find(',', tid) - tid);
+    };
+    auto first = traced_thread();
+    for (int i = 0; i < 10; ++i) CHECK(traced_thread() == first);
+  }
+}
@@ -0,0 +1,146 @@
+#include "hash_join.h"
+
+#include <range/v3/all.hpp>
+#include "doctest.h"
+#include "scratch_dir.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using toby::generator;
+using toby::hash_join;
+
+struct row {
+  std::uint32_t key;
+  std::uint32_t value;
+};
+
+static bool operator==(const row& a, const row& b) {
+  return a.key == b.key && a.value == b.value;
+}
+static bool operator<(const row& a, const row& b) {
+  return std::make_pair(a.key, a.value) < std::make_pair(b.key, b.value);
+}
+
+/// `n` rows with keys 0, step, 2 * step, ... modulo `keys`.
+static generator<row> rows(std::uint32_t n, std::uint32_t step, std::uint32_t keys) {
+  for (std::uint32_t i = 0; i < n; ++i) co_yield row{i * step % keys, i};
+}
+
+static auto key_of = [](const row& r) { return r.key; };
+
+using match = std::pair<row, row>;
+
+static std::vector<match> sorted(std::vector<match> v) {
+  std::sort(v.begin(), v.end());
+  return v;
+}
+
+/// The join, done with a std::multimap.
+static std::vector<match> reference_join(generator<row> build, generator<row> probe) {
+  std::multimap<std::uint32_t, row> left;
+  RANGES_FOR(auto&& r, build) { left.emplace(r.key, r); }
+  std::vector<match> out;
+  RANGES_FOR(auto&& r, probe) {
+    auto [first, last] = left.equal_range(r.key);
+    for (; first != last; ++first) out.emplace_back(first->second, r);
+  }
+  return sorted(std::move(out));
+}
+
+TEST_CASE("hash_join yields every matching pair in probe order") {
+  // Each build key appears twice; probe keys run past the build keys.
+  std::vector<match> out;
+  RANGES_FOR(auto&& m, hash_join(rows(100, 1, 50), rows(300, 7, 80), key_of, key_of)) {
+    out.push_back(m);
+  }
+  REQUIRE(!out.empty());
+  for (std::size_t i = 1; i < out.size(); ++i) {
+    CHECK(out[i - 1].second.value <= out[i].second.value);
+  }
+  CHECK(sorted(out) == reference_join(rows(100, 1, 50), rows(300, 7, 80)));
+}
+
+TEST_CASE("hash_join with nothing to match") {
+  int matches = 0;
+  RANGES_FOR(auto&& m, hash_join(rows(0, 1, 1), rows(10, 1, 10), key_of, key_of)) {
+    (void)m;
+    ++matches;
+  }
+  RANGES_FOR(auto&& m, hash_join(rows(10, 1, 10), rows(0, 1, 1), key_of, key_of)) {
+    (void)m;
+    ++matches;
+  }
+  CHECK(matches == 0);
+}
+
+TEST_CASE("hash_join with different row types") {
+  auto names = []() -> generator<std::string> {
+    for (auto s : {"one", "three", "five", "eight"}) co_yield s;
+  };
+  auto length = [](const std::string& s) { return s.size(); };
+  auto id     = [](std::size_t n) { return n; };
+  std::vector<std::pair<std::string, std::size_t>> out;
+  auto lengths = [](std::size_t n) -> generator<std::size_t> {
+    for (std::size_t i = 0; i < n; ++i) co_yield i;
+  };
+  RANGES_FOR(auto&& m, hash_join(names(), lengths(6), length, id)) {
+    out.push_back(m);
+  }
+  using pairs = std::vector<std::pair<std::string, std::size_t>>;
+  CHECK(out == pairs({{"one", 3}, {"five", 4}, {"three", 5}, {"eight", 5}}));
+}
+
+TEST_CASE("hash_join spills both sides when the build side is too big") {
+  scratch_dir dir("toby-join-test");
+  std::vector<match> out;
+  // About 40 bytes a row, so the table is split into a few hundred partitions over
+  // two levels.
+  auto joined = hash_join(rows(20000, 3, 15000), rows(30000, 5, 20000), key_of, key_of,
+                          16 * 1024, dir.path);
+  RANGES_FOR(auto&& m, joined) {
+    if (out.empty()) CHECK(dir.files() > 0);
+    out.push_back(m);
+  }
+  CHECK(dir.files() == 0);
+  CHECK(sorted(out) == reference_join(rows(20000, 3, 15000), rows(30000, 5, 20000)));
+}
+
+TEST_CASE("hash_join joins a partition of one key in memory") {
+  scratch_dir dir("toby-join-test");
+  std::size_t matches = 0;
+  auto joined =
+      hash_join(rows(3000, 0, 1), rows(10, 0, 1), key_of, key_of, 1024, dir.path);
+  RANGES_FOR(auto&& m, joined) {
+    (void)m;
+    ++matches;
+  }
+  CHECK(matches == 3000 * 10);
+  CHECK(dir.files() == 0);
+}
+
+TEST_CASE("hash_join removes its files when abandoned") {
+  scratch_dir dir("toby-join-test");
+  {
+    auto joined = hash_join(rows(5000, 1, 5000), rows(5000, 1, 5000), key_of, key_of,
+                            4096, dir.path);
+    auto it = joined.begin();
+    CHECK((*it).first.key == (*it).second.key);
+    CHECK(dir.files() > 0);
+  }
+  CHECK(dir.files() == 0);
+}
+
+TEST_CASE("hash_join can't spill rows that aren't trivially copyable") {
+  auto words = [](int n) -> generator<std::string> {
+    for (int i = 0; i < n; ++i) co_yield std::to_string(i);
+  };
+  auto id     = [](const std::string& s) { return s; };
+  auto joined = hash_join(words(1000), words(10), id, id, 1024);
+  CHECK_THROWS_AS(joined.begin(), const std::length_error&);
+}
@@ -0,0 +1,142 @@
+#include "hash_partition.h"
+
+#include <range/v3/all.hpp>
+#include "doctest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using toby::generator;
+using toby::hash_partition;
+using toby::spsc_queue;
+
+static generator<int> numbers(int n, std::atomic<int>* pulled = nullptr) {
+  for (int i = 0; i < n; ++i) {
+    if (pulled) ++*pulled;
+    co_yield i;
+  }
+}
+
+TEST_CASE("spsc_queue") {
+  spsc_queue<int> q(3);
+  CHECK(q.capacity() == 3);
+  for (int i = 0; i < 3; ++i) CHECK(q.try_push(int(i)));
+  CHECK(!q.try_push(3));
+  int x = -1;
+  for (int i = 0; i < 3; ++i) {
+    REQUIRE(q.try_pop(x));
+    CHECK(x == i);
+  }
+  CHECK(!q.try_pop(x));
+  // Around the end of the slots, which are rounded up to four.
+  for (int i = 0; i < 3; ++i) CHECK(q.try_push(int(i)));
+  CHECK(!q.try_push(3));
+  for (int i = 0; i < 3; ++i) {
+    REQUIRE(q.try_pop(x));
+    CHECK(x == i);
+  }
+  CHECK(q.try_push(5));
+  q.close();
+  CHECK(q.pop(x));
+  CHECK(x == 5);
+  CHECK(!q.pop(x));
+}
+
+TEST_CASE("spsc_queue between two threads") {
+  spsc_queue<std::vector<int>> q(2);
+  std::thread producer([&q] {
+    for (int i = 0; i < 10000; ++i) q.push(std::vector<int>(3, i));
+    q.close();
+  });
+  std::vector<int> batch;
+  int expected = 0;
+  while (q.pop(batch)) {
+    CHECK(batch == std::vector<int>(3, expected++));
+  }
+  producer.join();
+  CHECK(expected == 10000);
+}
+
+TEST_CASE("spsc_queue cancel wakes a waiting producer") {
+  spsc_queue<int> q(1);
+  CHECK(q.try_push(1));
+  std::thread consumer([&q] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    q.cancel();
+  });
+  CHECK(!q.push(2));
+  consumer.join();
+  int x;
+  CHECK(!q.pop(x));
+}
+
+TEST_CASE("hash_partition sends each key to one partition") {
+  std::vector<std::map<int, int>> counts(4);
+  std::vector<std::thread::id> threads(4);
+  auto key = [](int x) { return x % 100; };
+  hash_partition(numbers(10000), 4, key, [&](std::size_t p, generator<int> stream) {
+    threads[p] = std::this_thread::get_id();
+    RANGES_FOR(int x, stream) { ++counts[p][key(x)]; }
+  });
+  std::set<int> keys;
+  for (auto& partition : counts) {
+    for (auto [k, n] : partition) {
+      CHECK(keys.insert(k).second);
+      CHECK(n == 100);
+    }
+  }
+  CHECK(keys.size() == 100);
+  CHECK(std::set<std::thread::id>(threads.begin(), threads.end()).size() == 4);
+  CHECK(threads[0] != std::this_thread::get_id());
+}
+
+TEST_CASE("hash_partition waits for a slow consumer") {
+  std::atomic<int> pulled{0};
+  int most = 0;
+  auto key = [](int x) { return x; };
+  // 16 ints fill one cache line, so batches are exactly 16 elements.
+  hash_partition(numbers(2000, &pulled), 1, key,
+                 [&](std::size_t, generator<int> stream) {
+                   int consumed = 0;
+                   RANGES_FOR(int x, stream) {
+                     (void)x;
+                     ++consumed;
+                     most = std::max(most, pulled - consumed);
+                   }
+                   CHECK(consumed == 2000);
+                 },
+                 16, 4);
+  // The batch being filled, those queued and the one being consumed.
+  CHECK(most <= 16 * (4 + 2));
+}
+
+TEST_CASE("hash_partition drops the rest of a partition whose consumer stops") {
+  std::atomic<int> total{0};
+  auto key = [](int x) { return x; };
+  hash_partition(numbers(10000), 3, key, [&](std::size_t p, generator<int> stream) {
+    if (p == 0) return;
+    RANGES_FOR(int x, stream) {
+      (void)x;
+      ++total;
+    }
+  }, 8, 1);
+  CHECK(total > 0);
+  CHECK(total < 10000);
+}
+
+TEST_CASE("hash_partition rethrows from a consumer") {
+  auto key  = [](int x) { return x; };
+  auto fail = [](std::size_t p, generator<int> stream) {
+    RANGES_FOR(int x, stream) {
+      if (p == 1 && x > 100) throw std::runtime_error("fail");
+    }
+  };
+  CHECK_THROWS_AS(hash_partition(numbers(100000), 2, key, fail, 8, 1),
+                  const std::runtime_error&);
+}
@@ -0,0 +1,105 @@
+#include "latency_histogram.h"
+
+#include <range/v3/all.hpp>
+#include "doctest.h"
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using toby::histogram_snapshot;
+using toby::latency_histogram;
+
+TEST_CASE("histogram buckets") {
+  SUBCASE("small values are exact") {
+    for (std::uint64_t v = 0; v < 32; ++v) {
+      int i = histogram_snapshot::bucket_index(v);
+      CHECK(histogram_snapshot::bucket_lowest(i) == v);
+      CHECK(histogram_snapshot::bucket_highest(i) == v);
+    }
+  }
+  SUBCASE("large values are within their bucket") {
+    for (std::uint64_t v : {32ull, 33ull, 63ull, 64ull, 1000ull, 123456789ull,
+                            ~0ull >> 1, ~0ull}) {
+      int i = histogram_snapshot::bucket_index(v);
+      REQUIRE(i < histogram_snapshot::bucket_count);
+      CHECK(histogram_snapshot::bucket_lowest(i) <= v);
+      CHECK(histogram_snapshot::bucket_highest(i) >= v);
+      auto width =
+          histogram_snapshot::bucket_highest(i) - histogram_snapshot::bucket_lowest(i);
+      CHECK(width <= v / 32);
+    }
+  }
+  SUBCASE("buckets are contiguous") {
+    for (int i = 1; i < histogram_snapshot::bucket_count; ++i) {
+      CHECK(histogram_snapshot::bucket_lowest(i) ==
+            histogram_snapshot::bucket_highest(i - 1) + 1);
+    }
+  }
+}
+
+TEST_CASE("histogram percentiles") {
+  latency_histogram h;
+  for (std::uint64_t v = 1; v <= 1000; ++v) h.record(v);
+  auto s = h.snapshot();
+  CHECK(s.count() == 1000);
+  CHECK(s.min() == 1);
+  CHECK(s.max() >= 1000);
+  CHECK(s.max() <= 1000 + 1000 / 32);
+  CHECK(s.value_at_percentile(50) >= 500);
+  CHECK(s.value_at_percentile(50) <= 500 + 500 / 32);
+  CHECK(s.value_at_percentile(100) == s.max());
+}
+
+TEST_CASE("histogram recording from several threads") {
+  latency_histogram h;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&h, t] {
+      for (int i = 0; i < 1000; ++i) h.record(static_cast<std::uint64_t>(t));
+    });
+  }
+  for (auto& t : threads) t.join();
+  auto s = h.snapshot();
+  CHECK(s.count() == 4000);
+  CHECK(s.value_at_percentile(25) == 0);
+  CHECK(s.max() == 3);
+
+  SUBCASE("snapshots merge") {
+    latency_histogram other;
+    other.record(std::uint64_t(100));
+    s.merge(other.snapshot());
+    CHECK(s.count() == 4001);
+    CHECK(s.max() >= 100);
+    CHECK(s.max() <= 100 + 100 / 32);
+  }
+}
+
+TEST_CASE("one thread recording into more histograms than it caches") {
+  std::vector<latency_histogram> many(100);
+  for (int round = 0; round < 3; ++round) {
+    for (auto& h : many) h.record(std::uint64_t(7));
+  }
+  for (auto& h : many) CHECK(h.snapshot().count() == 3);
+}
+
+toby::generator<int> slow_ints(int n) {
+  for (int i = 0; i < n; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    co_yield i;
+  }
+}
+
+TEST_CASE("recording latency of a pipeline stage") {
+  latency_histogram h;
+  std::vector<int> v;
+  RANGES_FOR(int x, slow_ints(5) | toby::record_latency(h)) { v.push_back(x); }
+  CHECK(v == std::vector<int>({0, 1, 2, 3, 4}));
+  auto s = h.snapshot();
+  CHECK(s.count() == 5);
+  CHECK(s.min() >= 1000000);
+
+  std::ostringstream os;
+  s.write_summary(os);
+  CHECK(os.str().find("count=5") == 0);
+}
@@ -0,0 +1,139 @@
+#include "mpsc_channel.h"
+
+#include <range/v3/all.hpp>
+#include "doctest.h"
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using toby::generator;
+using toby::mpsc_channel;
+
+template <class InputRange, class UnaryPredicate>
+generator<int> co_filter(InputRange range, UnaryPredicate pred) {
+  RANGES_FOR(auto&& x, range) {
+    if (pred(x)) co_yield x;
+  }
+}
+
+TEST_CASE("mpsc_channel on one thread") {
+  mpsc_channel<std::string> channel;
+  channel.push("a");
+  std::vector<std::string> batch{"b", "c"};
+  channel.push_batch(batch);
+  channel.push_batch(std::vector<std::string>{"d"});
+  channel.close();
+  std::vector<std::string> out;
+  RANGES_FOR(auto&& s, channel.stream()) { out.push_back(s); }
+  CHECK(out == std::vector<std::string>({"a", "b", "c", "d"}));
+  CHECK(batch.size() == 2);
+  CHECK(batch[0] == "b");
+}
+
+TEST_CASE("mpsc_channel from many producers into a pipeline") {
+  mpsc_channel<int> channel;
+  const int per_producer = 20000;
+  std::vector<std::thread> producers;
+  for (int p = 0; p < 4; ++p) {
+    producers.emplace_back([&channel, p] {
+      for (int i = 0; i < per_producer; i += 10) {
+        if (p % 2) {
+          for (int j = i; j < i + 10; ++j) channel.push(p * per_producer + j);
+        } else {
+          std::vector<int> batch;
+          for (int j = i; j < i + 10; ++j) batch.push_back(p * per_producer + j);
+          channel.push_batch(std::move(batch));
+        }
+      }
+    });
+  }
+  std::thread closer([&] {
+    for (auto& producer : producers) producer.join();
+    channel.close();
+  });
+
+  std::vector<int> last(4, -1);
+  int received = 0;
+  auto all     = [](int) { return true; };
+  RANGES_FOR(int x, co_filter(channel.stream(), all)) {
+    // Each producer's elements arrive in the order it pushed them.
+    int p = x / per_producer;
+    CHECK(x > last[p]);
+    last[p] = x;
+    ++received;
+  }
+  closer.join();
+  CHECK(received == 4 * per_producer);
+}
+
+TEST_CASE("mpsc_channel parks its consumer until a push") {
+  mpsc_channel<int> channel;
+  std::thread producer([&channel] {
+    for (int i = 0; i < 3; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      channel.push(i);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    channel.close();
+  });
+  std::vector<int> out;
+  RANGES_FOR(int x, channel.stream()) { out.push_back(x); }
+  producer.join();
+  CHECK(out == std::vector<int>({0, 1, 2}));
+}
+
+TEST_CASE("mpsc_channel destroys what wasn't received") {
+  auto counted = std::make_shared<int>(0);
+  {
+    mpsc_channel<std::shared_ptr<int>> channel;
+    for (int i = 0; i < 5; ++i) channel.push(counted);
+    auto stream = channel.stream();
+    auto it     = stream.begin();
+    CHECK(*it == counted);
+    CHECK(counted.use_count() == 6);
+  }
+  CHECK(counted.use_count() == 1);
+}
+
+/// Counts its instances, and throws from its copy constructor once `copies_left` runs
+/// out.
+struct fragile {
+  static int live;
+  static int copies_left;
+
+  fragile() { ++live; }
+  fragile(const fragile&) {
+    if (copies_left-- == 0) throw std::runtime_error("copy");
+    ++live;
+  }
+  ~fragile() { --live; }
+};
+int fragile::live        = 0;
+int fragile::copies_left = 0;
+
+TEST_CASE("mpsc_channel frees what a throwing push made") {
+  {
+    mpsc_channel<fragile> channel;
+    std::vector<fragile> batch(5);
+    fragile::copies_left = 3;
+    CHECK_THROWS_AS(channel.push_batch(batch), const std::runtime_error&);
+    CHECK(fragile::live == 5);
+    fragile::copies_left = 0;
+    CHECK_THROWS_AS(channel.push(batch[0]), const std::runtime_error&);
+    CHECK(fragile::live == 5);
+    fragile::copies_left = 100;
+    channel.push(batch[0]);
+    channel.close();
+    int received = 0;
+    RANGES_FOR(auto&& f, channel.stream()) {
+      (void)f;
+      ++received;
+    }
+    CHECK(received == 1);
+  }
+  CHECK(fragile::live == 0);
+}
@@ -0,0 +1,126 @@
+#include "parallel_reduce.h"
+
+#include <range/v3/all.hpp>
+#include "doctest.h"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using toby::generator;
+using toby::make_splittable;
+using toby::parallel_for_each;
+using toby::parallel_reduce;
+using toby::work_stealing_pool;
+
+static generator<int> ints(int first, int last) {
+  for (int i = first; i < last; ++i) {
+    co_yield i;
+  }
+}
+
+TEST_CASE("work stealing pool runs everything a task spawns") {
+  work_stealing_pool pool(4);
+  CHECK(pool.size() == 4);
+  std::atomic<int> ran{0};
+  std::function<void(int)> fan_out = [&](int depth) {
+    ++ran;
+    if (depth == 0) return;
+    for (int i = 0; i < 3; ++i) pool.spawn([&fan_out, depth] { fan_out(depth - 1); });
+  };
+  pool.run([&] { fan_out(5); });
+  CHECK(ran == 1 + 3 + 9 + 27 + 81 + 243);
+  // The pool can be run again.
+  pool.run([&] { ++ran; });
+  CHECK(ran == 365);
+}
+
+TEST_CASE("work stealing pool rethrows from a task once every task has finished") {
+  work_stealing_pool pool(3);
+  std::atomic<int> ran{0};
+  auto run = [&] {
+    pool.run([&] {
+      for (int i = 0; i < 20; ++i) {
+        pool.spawn([&ran, i] {
+          ++ran;
+          if (i == 7) throw std::runtime_error("7");
+        });
+      }
+    });
+  };
+  CHECK_THROWS_AS(run(), const std::runtime_error&);
+  CHECK(ran == 20);
+}
+
+TEST_CASE("splittable_range splits into pieces no bigger than its grain") {
+  auto source = make_splittable(ints, 0, 1000, 100);
+  std::vector<std::pair<int, int>> pieces;
+  std::function<void(const decltype(source)&)> walk = [&](const auto& s) {
+    if (s.divisible()) {
+      auto halves = s.split();
+      walk(halves.first);
+      walk(halves.second);
+    } else {
+      pieces.emplace_back(s.size(), *s.generate().begin());
+    }
+  };
+  walk(source);
+  int next = 0;
+  for (auto [size, first] : pieces) {
+    CHECK(size <= 100);
+    CHECK(first == next);
+    next += size;
+  }
+  CHECK(next == 1000);
+}
+
+TEST_CASE("parallel_reduce sums a splittable range") {
+  work_stealing_pool pool(4);
+  auto plus = [](long long a, long long b) { return a + b; };
+  for (int grain : {1, 7, 1000, 100000}) {
+    CHECK(parallel_reduce(pool, make_splittable(ints, 0, 10000, grain), 0ll, plus) ==
+          10000ll * 9999 / 2);
+  }
+  CHECK(parallel_reduce(pool, make_splittable(ints, 5, 5, 1), 0ll, plus) == 0);
+}
+
+TEST_CASE("parallel_reduce combines pieces in order") {
+  work_stealing_pool pool(4);
+  auto append = [](std::string s, const auto& x) {
+    if constexpr (std::is_same_v<std::decay_t<decltype(x)>, std::string>) {
+      return s + x;
+    } else {
+      return s + static_cast<char>('a' + x % 26);
+    }
+  };
+  auto result = parallel_reduce(pool, make_splittable(ints, 0, 260, 3), std::string(),
+                                append);
+  std::string expected;
+  for (int i = 0; i < 260; ++i) expected += static_cast<char>('a' + i % 26);
+  CHECK(result == expected);
+}
+
+TEST_CASE("parallel_reduce rethrows from op") {
+  work_stealing_pool pool(2);
+  auto fail_at_500 = [](int a, int b) {
+    if (b == 500) throw std::runtime_error("500");
+    return a + b;
+  };
+  CHECK_THROWS_AS(parallel_reduce(pool, make_splittable(ints, 0, 1000, 10), 0,
+                                  fail_at_500),
+                  const std::runtime_error&);
+}
+
+TEST_CASE("parallel_for_each visits every element once") {
+  work_stealing_pool pool(4);
+  std::vector<std::atomic<int>> visits(5000);
+  auto visit = [&visits](int i) { ++visits[i]; };
+  parallel_for_each(pool, make_splittable(ints, 0, 5000, 64), visit);
+  int wrong = 0;
+  for (auto& v : visits) wrong += v != 1;
+  CHECK(wrong == 0);
+}
@@ -0,0 +1,198 @@
+#include "parallel_transform.h"
+
+#include <range/v3/all.hpp>
+#include "doctest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using toby::generator;
+using toby::parallel_transform;
+using toby::parallel_transform_filter;
+
+TEST_CASE("thread pool") {
+  std::atomic<int> ran{0};
+  {
+    toby::thread_pool pool(3);
+    CHECK(pool.size() == 3);
+    for (int i = 0; i < 100; ++i) pool.submit([&ran] { ++ran; });
+  }
+  CHECK(ran == 100);
+}
+
+generator<int> numbers(int n, std::atomic<int>* pulled = nullptr) {
+  for (int i = 0; i < n; ++i) {
+    if (pulled) ++*pulled;
+    co_yield i;
+  }
+}
+
+TEST_CASE("parallel_transform yields results in order") {
+  // Later elements finish first, so results arrive out of order.
+  auto slow_square = [](int x) {
+    std::this_thread::sleep_for(std::chrono::microseconds(100 * (x % 4)));
+    return x * x;
+  };
+  std::vector<int> out;
+  RANGES_FOR(int x, parallel_transform(numbers(50), slow_square, 4, 8)) {
+    out.push_back(x);
+  }
+  REQUIRE(out.size() == 50);
+  for (int i = 0; i < 50; ++i) CHECK(out[i] == i * i);
+}
+
+TEST_CASE("parallel_transform composes with the pipe syntax") {
+  std::vector<int> out;
+  RANGES_FOR(int x, numbers(10) | parallel_transform([](int x) { return x + 1; }, 2, 4)) {
+    out.push_back(x);
+  }
+  CHECK(out == std::vector<int>({1, 2, 3, 4, 5, 6, 7, 8, 9, 10}));
+}
+
+TEST_CASE("parallel_transform keeps at most window elements in flight") {
+  std::atomic<int> pulled{0};
+  int consumed = 0;
+  int most     = 0;
+  auto id      = [](int x) { return x; };
+  RANGES_FOR(int x, parallel_transform(numbers(100, &pulled), id, 4, 5)) {
+    (void)x;
+    ++consumed;
+    most = std::max(most, pulled - consumed);
+  }
+  CHECK(consumed == 100);
+  CHECK(most <= 5);
+}
+
+TEST_CASE("parallel_transform runs fn on the workers") {
+  auto consumer = std::this_thread::get_id();
+  auto thread   = [](int) { return std::this_thread::get_id(); };
+  RANGES_FOR(auto id, parallel_transform(numbers(20), thread, 2, 4)) {
+    CHECK(id != consumer);
+  }
+}
+
+TEST_CASE("parallel_transform rethrows from fn") {
+  auto fail_at_7 = [](int x) {
+    if (x == 7) throw std::runtime_error("7");
+    return x;
+  };
+  std::vector<int> out;
+  auto g = parallel_transform(numbers(20), fail_at_7, 3, 4);
+  CHECK_THROWS_AS(
+      [&] {
+        RANGES_FOR(int x, g) { out.push_back(x); }
+      }(),
+      const std::runtime_error&);
+  CHECK(out == std::vector<int>({0, 1, 2, 3, 4, 5, 6}));
+}
+
+TEST_CASE("parallel_transform of move-only results") {
+  auto box = [](int x) { return std::make_unique<int>(x); };
+  int expected = 0;
+  RANGES_FOR(auto&& p, parallel_transform(numbers(10), box, 2, 3)) {
+    CHECK(*p == expected++);
+  }
+  CHECK(expected == 10);
+}
+
+TEST_CASE("abandoning a parallel_transform part way through") {
+  std::atomic<int> calls{0};
+  auto count = [&calls](int x) {
+    ++calls;
+    return x;
+  };
+  {
+    auto g = parallel_transform(numbers(1000), count, 2, 16);
+    auto i = g.begin();
+    CHECK(*i == 0);
+  }
+  CHECK(calls <= 16);
+}
+
+TEST_CASE("parallel_transform_filter yields every kept result once") {
+  auto square  = [](int x) { return x * x; };
+  auto is_even = [](int x) { return x % 2 == 0; };
+  std::vector<int> out;
+  RANGES_FOR(int x, parallel_transform_filter(numbers(1001), square, is_even, 4, 16)) {
+    out.push_back(x);
+  }
+  std::sort(out.begin(), out.end());
+  std::vector<int> expected;
+  for (int i = 0; i <= 1000; i += 2) expected.push_back(i * i);
+  CHECK(out == expected);
+}
+
+TEST_CASE("parallel_transform_filter yields batches as they finish") {
+  // The first batch is held back until the other three have been consumed, so it
+  // must be yielded last.
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::size_t consumed = 0;
+  auto held_first      = [&](int x) {
+    if (x == 0) {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&] { return consumed == 12; });
+    }
+    return x;
+  };
+  auto all = [](int) { return true; };
+  std::vector<int> out;
+  RANGES_FOR(int x, numbers(16) | parallel_transform_filter(held_first, all, 4, 4)) {
+    out.push_back(x);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      ++consumed;
+    }
+    cv.notify_one();
+  }
+  REQUIRE(out.size() == 16);
+  CHECK(std::all_of(out.begin(), out.begin() + 12, [](int x) { return x >= 4; }));
+  CHECK(std::all_of(out.begin() + 12, out.end(), [](int x) { return x < 4; }));
+}
+
+TEST_CASE("parallel_transform_filter keeps a bounded number of batches in flight") {
+  std::atomic<int> pulled{0};
+  int consumed = 0;
+  int most     = 0;
+  auto id      = [](int x) { return x; };
+  auto all     = [](int) { return true; };
+  RANGES_FOR(int x, parallel_transform_filter(numbers(200, &pulled), id, all, 2, 5)) {
+    (void)x;
+    ++consumed;
+    most = std::max(most, pulled - consumed);
+  }
+  CHECK(consumed == 200);
+  // Two batches per thread, plus the one being yielded.
+  CHECK(most <= 5 * 5);
+}
+
+TEST_CASE("parallel_transform_filter rethrows from fn") {
+  auto fail_at_7 = [](int x) {
+    if (x == 7) throw std::runtime_error("7");
+    return x;
+  };
+  auto all = [](int) { return true; };
+  auto g   = parallel_transform_filter(numbers(20), fail_at_7, all, 3, 2);
+  CHECK_THROWS_AS(
+      [&] {
+        RANGES_FOR(int x, g) { (void)x; }
+      }(),
+      const std::runtime_error&);
+}
+
+TEST_CASE("parallel_transform_filter of move-only results") {
+  auto box     = [](int x) { return std::make_unique<int>(x); };
+  auto nonnull = [](const std::unique_ptr<int>& p) { return p != nullptr; };
+  int sum      = 0;
+  RANGES_FOR(auto&& p, parallel_transform_filter(numbers(10), box, nonnull, 2, 3)) {
+    sum += *p;
+  }
+  CHECK(sum == 45);
+}
@@ -0,0 +1,155 @@
+#include "pipelined.h"
+
+#include <range/v3/all.hpp>
+#include "doctest.h"
+
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using toby::generator;
+using toby::pipelined;
+
+static generator<int> numbers(int n) {
+  for (int i = 0; i < n; ++i) {
+    co_yield i;
+  }
+}
+
+// Stage coroutines as they would be written for a single-threaded chain.
+template <class InputRange, class UnaryPredicate>
+generator<int> co_remove_if(InputRange range, UnaryPredicate pred) {
+  RANGES_FOR(auto&& x, range) {
+    if (!pred(x)) co_yield x;
+  }
+}
+
+template <class InputRange, class Fn>
+generator<int> co_transform(InputRange range, Fn fn) {
+  RANGES_FOR(auto&& x, range) { co_yield fn(x); }
+}
+
+template <class InputRange>
+generator<std::thread::id> co_thread_ids(InputRange range) {
+  RANGES_FOR(auto&& x, range) {
+    (void)x;
+    co_yield std::this_thread::get_id();
+  }
+}
+
+static bool is_odd(int x) { return x % 2 != 0; }
+static int squared(int x) { return x * x; }
+static int same(int x) { return x; }
+
+TEST_CASE("pipelined runs a chain of stage coroutines") {
+  auto odd_out = [](auto in) { return co_remove_if(std::move(in), is_odd); };
+  auto square  = [](auto in) { return co_transform(std::move(in), squared); };
+  std::vector<int> out;
+  RANGES_FOR(int x, pipelined(numbers(1000), odd_out, square)) { out.push_back(x); }
+  REQUIRE(out.size() == 500);
+  for (int i = 0; i < 500; ++i) CHECK(out[i] == 4 * i * i);
+}
+
+TEST_CASE("pipelined runs each stage on its own thread") {
+  auto first  = [](auto in) { return co_thread_ids(std::move(in)); };
+  auto second = [](auto in) {
+    return [](auto in) -> generator<std::pair<std::thread::id, std::thread::id>> {
+      RANGES_FOR(auto&& id, in) {
+        co_yield std::make_pair(id, std::this_thread::get_id());
+      }
+    }(std::move(in));
+  };
+  std::set<std::thread::id> ids;
+  RANGES_FOR(auto&& pair, pipelined(numbers(10), first, second)) {
+    ids.insert(pair.first);
+    ids.insert(pair.second);
+  }
+  ids.insert(std::this_thread::get_id());
+  CHECK(ids.size() == 3);
+}
+
+TEST_CASE("pipelined reports per-stage stats") {
+  toby::pipeline_stats stats;
+  toby::pipeline_options options;
+  options.batch_size = 16;
+  options.stats      = &stats;
+  auto odd_out = [](auto in) { return co_remove_if(std::move(in), is_odd); };
+  int consumed = 0;
+  RANGES_FOR(int x, toby::pipelined_with(options, numbers(1000), odd_out)) {
+    (void)x;
+    ++consumed;
+  }
+  REQUIRE(stats.stages.size() == 3);
+  CHECK(stats.stages[0].elements == 1000);
+  CHECK(stats.stages[1].elements == 500);
+  CHECK(stats.stages[2].elements == 500);
+  for (auto& stage : stats.stages) {
+    CHECK(stage.seconds > 0);
+    CHECK(stage.utilisation() >= 0);
+    CHECK(stage.utilisation() <= 1);
+  }
+  CHECK(stats.bottleneck() < 3);
+}
+
+TEST_CASE("pipelined rethrows from a stage") {
+  auto fail_at_500 = [](auto in) {
+    return co_transform(std::move(in), [](int x) {
+      if (x == 500) throw std::runtime_error("500");
+      return x;
+    });
+  };
+  int consumed = 0;
+  auto g       = pipelined(numbers(100000), fail_at_500);
+  CHECK_THROWS_AS(
+      [&] {
+        RANGES_FOR(int x, g) {
+          (void)x;
+          ++consumed;
+        }
+      }(),
+      const std::runtime_error&);
+  CHECK(consumed <= 500);
+}
+
+TEST_CASE("pipelined drains the stages after one that throws") {
+  auto fail_at_500 = [](auto in) {
+    return co_transform(std::move(in), [](int x) {
+      if (x == 500) throw std::runtime_error("500");
+      return x;
+    });
+  };
+  auto identity = [](auto in) { return co_transform(std::move(in), same); };
+  toby::pipeline_options options;
+  options.batch_size = 64;
+  int consumed       = 0;
+  auto g =
+      toby::pipelined_with(options, numbers(100000), identity, fail_at_500, identity);
+  CHECK_THROWS_AS(
+      [&] {
+        RANGES_FOR(int x, g) {
+          CHECK(x == consumed);
+          ++consumed;
+        }
+      }(),
+      const std::runtime_error&);
+  CHECK(consumed == 500);
+}
+
+TEST_CASE("abandoning a pipelined generator stops its stages") {
+  auto identity = [](auto in) { return co_transform(std::move(in), same); };
+  auto g        = pipelined(numbers(1000000000), identity, identity);
+  auto i        = g.begin();
+  CHECK(*i == 0);
+}
+
+TEST_CASE("pipelined with no stages") {
+  auto words = [](int n) -> generator<std::string> {
+    for (int i = 0; i < n; ++i) co_yield std::string(i, 'x');
+  };
+  std::vector<std::string> out;
+  RANGES_FOR(auto&& s, pipelined(words(5))) { out.push_back(s); }
+  CHECK(out == std::vector<std::string>({"", "x", "xx", "xxx", "xxxx"}));
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <iterator>
+#include <string>
+
+/// A fresh directory under the system's temporary directory for a test's spill files,
+/// removed with everything in it.
+struct scratch_dir {
+  explicit scratch_dir(const std::string& name)
+      : path(std::filesystem::temp_directory_path() / name) {
+    std::filesystem::remove_all(path);
+    std::filesystem::create_directory(path);
+  }
+  scratch_dir(const scratch_dir&) = delete;
+  scratch_dir& operator=(const scratch_dir&) = delete;
+  ~scratch_dir() { std::filesystem::remove_all(path); }
+
+  std::size_t files() const {
+    return std::distance(std::filesystem::directory_iterator(path),
+                         std::filesystem::directory_iterator());
+  }
+
+  std::filesystem::path path;
+};
@@ -0,0 +1,142 @@
+#include "set_operations.h"
+
+#include <range/v3/all.hpp>
+#include "doctest.h"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+using toby::generator;
+
+/// `n` sorted values from [0, range), with repeats.
+static std::vector<int> sorted_values(int n, int range, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> value(0, range - 1);
+  std::vector<int> v(n);
+  for (auto& x : v) x = value(rng);
+  std::sort(v.begin(), v.end());
+  return v;
+}
+
+static generator<int> one_by_one(std::vector<int> v) {
+  for (int x : v) co_yield x;
+}
+
+static generator<int> in_blocks(std::vector<int> v, std::size_t block) {
+  for (std::size_t i = 0; i < v.size(); i += block) {
+    co_yield toby::elements_of(
+        std::span<int>(v.data() + i, std::min(block, v.size() - i)));
+  }
+}
+
+template <class Range>
+static std::vector<int> to_vector(Range&& range) {
+  std::vector<int> v;
+  RANGES_FOR(int x, range) { v.push_back(x); }
+  return v;
+}
+
+/// Checks `op` against the standard algorithm `expected` for every pairing of sources.
+template <class Op, class Expected>
+static void check_against_std(Op op, Expected expected) {
+  for (unsigned seed = 0; seed < 20; ++seed) {
+    auto a = sorted_values(seed * 37 % 200, 100 + seed * 13, seed);
+    auto b = sorted_values(seed * 53 % 300, 150, seed + 100);
+    std::vector<int> want;
+    expected(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(want));
+    CHECK(to_vector(op(std::span<const int>(a), std::span<const int>(b))) == want);
+    CHECK(to_vector(op(one_by_one(a), one_by_one(b))) == want);
+    CHECK(to_vector(op(in_blocks(a, 7), in_blocks(b, 16))) == want);
+    CHECK(to_vector(op(one_by_one(a), in_blocks(b, 5))) == want);
+    CHECK(to_vector(op(in_blocks(a, 64), std::span<const int>(b))) == want);
+  }
+}
+
+TEST_CASE("set_intersection agrees with std::set_intersection") {
+  check_against_std([](auto a, auto b) { return toby::set_intersection(a, b); },
+                    [](auto... args) { std::set_intersection(args...); });
+}
+
+TEST_CASE("set_union agrees with std::set_union") {
+  check_against_std([](auto a, auto b) { return toby::set_union(a, b); },
+                    [](auto... args) { std::set_union(args...); });
+}
+
+TEST_CASE("set_difference agrees with std::set_difference") {
+  check_against_std([](auto a, auto b) { return toby::set_difference(a, b); },
+                    [](auto... args) { std::set_difference(args...); });
+}
+
+TEST_CASE("set operations with an empty side") {
+  std::vector<int> none;
+  std::vector<int> some = {1, 2, 2, 3};
+  CHECK(to_vector(toby::set_intersection(one_by_one(none), one_by_one(some))).empty());
+  CHECK(to_vector(toby::set_intersection(one_by_one(some), one_by_one(none))).empty());
+  CHECK(to_vector(toby::set_union(one_by_one(none), in_blocks(some, 3))) == some);
+  CHECK(to_vector(toby::set_union(in_blocks(some, 3), one_by_one(none))) == some);
+  CHECK(to_vector(toby::set_difference(in_blocks(some, 2), one_by_one(none))) == some);
+  CHECK(to_vector(toby::set_difference(one_by_one(none), one_by_one(some))).empty());
+}
+
+TEST_CASE("set operations with a comparator") {
+  std::vector<int> a = {9, 7, 5, 3, 1};
+  std::vector<int> b = {8, 7, 6, 5, 4};
+  auto greater       = std::greater<>();
+  CHECK(to_vector(toby::set_intersection(a, b, greater)) == std::vector<int>({7, 5}));
+  CHECK(to_vector(toby::set_union(one_by_one(a), one_by_one(b), greater)) ==
+        std::vector<int>({9, 8, 7, 6, 5, 4, 3, 1}));
+  CHECK(to_vector(toby::set_difference(in_blocks(a, 2), b, greater)) ==
+        std::vector<int>({9, 3, 1}));
+}
+
+TEST_CASE("set_intersection gallops past a dense side") {
+  std::vector<int> dense(100000);
+  for (int i = 0; i < 100000; ++i) dense[i] = i;
+  std::vector<int> sparse = {10, 5000, 5001, 77777, 99999, 100001};
+  int comparisons         = 0;
+  auto counted            = [&comparisons](int x, int y) {
+    ++comparisons;
+    return x < y;
+  };
+  auto both = to_vector(toby::set_intersection(one_by_one(sparse), in_blocks(dense, 4096),
+                                               counted));
+  CHECK(both == std::vector<int>({10, 5000, 5001, 77777, 99999}));
+  // A linear merge would compare about 100000 times.
+  CHECK(comparisons < 2000);
+}
+
+TEST_CASE("set_union yields runs in place") {
+  std::vector<int> a = {1, 2, 3, 10, 11, 12};
+  std::vector<int> b = {4, 5, 6, 7};
+  auto g             = toby::set_union(std::span<int>(a), std::span<int>(b));
+  auto it            = g.begin();
+  // 1, 2, 3 are yielded together, straight from a.
+  CHECK(&*it == a.data());
+  CHECK(it.block_end() == a.data() + 3);
+  std::vector<int> out;
+  for (; it != g.end(); ++it) out.push_back(*it);
+  CHECK(out == std::vector<int>({1, 2, 3, 4, 5, 6, 7, 10, 11, 12}));
+}
+
+TEST_CASE("set_union and set_difference copy runs of a const range") {
+  const std::vector<std::string> a = {"a long string, to be sure it's moved", "c", "e"};
+  const std::vector<std::string> b = {"b", "d"};
+  auto moved_out = [](generator<std::string> g) {
+    std::vector<std::string> out;
+    for (auto it = g.begin(); it != g.end(); ++it) out.push_back(std::move(*it));
+    return out;
+  };
+  using strings = std::vector<std::string>;
+  CHECK(moved_out(toby::set_union(std::span<const std::string>(a),
+                                  std::span<const std::string>(b))) ==
+        strings({a[0], "b", "c", "d", "e"}));
+  CHECK(moved_out(toby::set_difference(std::span<const std::string>(a),
+                                       std::span<const std::string>(b))) == a);
+  CHECK(a == strings({"a long string, to be sure it's moved", "c", "e"}));
+  CHECK(b == strings({"b", "d"}));
+}
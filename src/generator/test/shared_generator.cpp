@@ -0,0 +1,86 @@
+#include "shared_generator.h"
+
+#include "doctest.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using toby::generator;
+using toby::shared_generator;
+
+static generator<int> numbers(int n) {
+  for (int i = 0; i < n; ++i) {
+    co_yield i;
+  }
+}
+
+TEST_CASE("shared_generator on one thread") {
+  shared_generator<int> shared(numbers(5));
+  shared_generator<int>::consumer consumer(shared);
+  std::vector<int> batch;
+  CHECK(consumer.take(batch, 2) == 2);
+  CHECK(*consumer.next() == 2);
+  CHECK(consumer.take(batch, 10) == 2);
+  CHECK(batch == std::vector<int>({0, 1, 3, 4}));
+  CHECK(!consumer.next());
+  CHECK(consumer.take(batch, 10) == 0);
+}
+
+TEST_CASE("shared_generator hands each element to one consumer") {
+  const int n = 100000;
+  shared_generator<int> shared(numbers(n));
+  std::vector<std::vector<int>> taken(8);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t] {
+      shared_generator<int>::consumer consumer(shared);
+      if (t % 2) {
+        while (auto x = consumer.next()) taken[t].push_back(*x);
+      } else {
+        while (consumer.take(taken[t], 1 + t) != 0) {
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  std::vector<int> all;
+  for (auto& mine : taken) {
+    CHECK(std::is_sorted(mine.begin(), mine.end()));
+    all.insert(all.end(), mine.begin(), mine.end());
+  }
+  std::sort(all.begin(), all.end());
+  REQUIRE(all.size() == n);
+  for (int i = 0; i < n; ++i) CHECK(all[i] == i);
+}
+
+TEST_CASE("shared_generator reuses the records of finished consumers") {
+  shared_generator<int> shared(numbers(100));
+  int total = 0;
+  for (int round = 0; round < 10; ++round) {
+    std::vector<std::thread> threads;
+    std::vector<int> counts(2);
+    for (int t = 0; t < 2; ++t) {
+      threads.emplace_back([&, t] {
+        shared_generator<int>::consumer consumer(shared);
+        for (int i = 0; i < 5; ++i) counts[t] += consumer.next().has_value();
+      });
+    }
+    for (auto& thread : threads) thread.join();
+    total += counts[0] + counts[1];
+  }
+  CHECK(total == 100);
+}
+
+TEST_CASE("shared_generator rethrows from the generator") {
+  auto failing = []() -> generator<int> {
+    co_yield 1;
+    throw std::runtime_error("fail");
+  };
+  shared_generator<int> shared(failing());
+  shared_generator<int>::consumer consumer(shared);
+  std::vector<int> batch;
+  CHECK(consumer.take(batch, 5) == 1);
+  CHECK_THROWS_AS(consumer.take(batch, 5), const std::runtime_error&);
+}
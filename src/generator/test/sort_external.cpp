@@ -0,0 +1,108 @@
+#include "sort_external.h"
+
+#include <range/v3/all.hpp>
+#include "doctest.h"
+#include "scratch_dir.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using toby::generator;
+using toby::sort_external;
+
+static generator<std::uint32_t> random_ints(int n, unsigned seed) {
+  std::mt19937 rng(seed);
+  for (int i = 0; i < n; ++i) {
+    co_yield rng();
+  }
+}
+
+static std::vector<std::uint32_t> sorted_random_ints(int n, unsigned seed) {
+  std::vector<std::uint32_t> v;
+  RANGES_FOR(auto x, random_ints(n, seed)) { v.push_back(x); }
+  std::sort(v.begin(), v.end());
+  return v;
+}
+
+TEST_CASE("sort_external of a range that fits in memory") {
+  scratch_dir dir("toby-sort-test");
+  std::vector<std::uint32_t> out;
+  auto sorted = sort_external(random_ints(1000, 1), std::less<>(), 1 << 20, dir.path);
+  RANGES_FOR(auto x, sorted) {
+    out.push_back(x);
+    CHECK(dir.files() == 0);
+  }
+  CHECK(out == sorted_random_ints(1000, 1));
+}
+
+TEST_CASE("sort_external spills runs and merges them") {
+  scratch_dir dir("toby-sort-test");
+  std::vector<std::uint32_t> out;
+  // Runs of half of 400 bytes are 50 elements, so there are 400 runs.
+  RANGES_FOR(auto x, sort_external(random_ints(20000, 2), std::less<>(), 400, dir.path)) {
+    out.push_back(x);
+  }
+  CHECK(out == sorted_random_ints(20000, 2));
+  CHECK(dir.files() == 0);
+}
+
+TEST_CASE("sort_external merges in several passes when there are too many runs") {
+  scratch_dir dir("toby-sort-test");
+  // Enough budget for four merge buffers, and runs of 32Ki elements.
+  const std::size_t budget = 4 * toby::detail::min_merge_buffer;
+  const int n              = 20 * budget / sizeof(std::uint32_t) + 123;
+  std::vector<std::uint32_t> out;
+  auto sorted = sort_external(random_ints(n, 3), std::greater<>(), budget, dir.path);
+  RANGES_FOR(auto x, sorted) {
+    out.push_back(x);
+  }
+  auto expected = sorted_random_ints(n, 3);
+  std::reverse(expected.begin(), expected.end());
+  CHECK(out == expected);
+  CHECK(dir.files() == 0);
+}
+
+TEST_CASE("sort_external removes its files when abandoned") {
+  scratch_dir dir("toby-sort-test");
+  {
+    auto sorted = sort_external(random_ints(5000, 4), std::less<>(), 1000, dir.path);
+    auto it     = sorted.begin();
+    CHECK(*it == sorted_random_ints(5000, 4).front());
+    CHECK(dir.files() > 0);
+  }
+  CHECK(dir.files() == 0);
+}
+
+TEST_CASE("sort_external of records") {
+  struct record {
+    std::uint32_t key;
+    float value;
+  };
+  auto records = [](int n) -> generator<record> {
+    for (int i = 0; i < n; ++i) co_yield record{std::uint32_t(n - i), float(i)};
+  };
+  auto by_key = [](const record& a, const record& b) { return a.key < b.key; };
+  std::uint32_t expected = 1;
+  RANGES_FOR(auto&& r, sort_external(records(3000), by_key, 1024)) {
+    CHECK(r.key == expected);
+    CHECK(r.value == float(3000 - expected));
+    ++expected;
+  }
+  CHECK(expected == 3001);
+}
+
+TEST_CASE("sort_external rethrows from its comparator") {
+  // A run of 2^18 elements, which is sorted in slices on a machine with several cores.
+  std::atomic<int> comparisons{0};
+  auto fragile = [&comparisons](std::uint32_t a, std::uint32_t b) {
+    if (++comparisons == 100000) throw std::runtime_error("compare");
+    return a < b;
+  };
+  auto sorted = sort_external(random_ints(1 << 18, 5), fragile, 2 << 20);
+  CHECK_THROWS_AS(sorted.begin(), const std::runtime_error&);
+}
@@ -0,0 +1,46 @@
+#!/bin/sh
+# Reports the build cost of the generator_code_size_<kind>_<stages> pipelines: the time
+# to compile each one, the size of its object file and .text sections, and the size of
+# the functions in its own namespace (the coroutine bodies, predicates and consuming
+# loop) per stage. Growth in the last column as stages are added points to template
+# instantiation blowup.
+#
+# Usage: tools/code_size.sh BUILD_DIR
+#
+# Configure BUILD_DIR with -DCMAKE_BUILD_TYPE=Release for representative code sizes.
+
+set -e
+
+build=${1:?usage: code_size.sh BUILD_DIR}
+units=$(find "$build" -path '*/code_size/*_*.cpp' | sed 's|.*/||; s|\.cpp$||' |
+  sort -t_ -k1,1 -k2,2n)
+if [ -z "$units" ]; then
+  echo "no generated pipelines in $build: run cmake first" >&2
+  exit 1
+fi
+
+printf '%-8s %6s %9s %10s %10s %10s %12s\n' kind stages compile_s object_b text_b \
+  own_b own_b/stage
+for unit in $units; do
+  kind=${unit%_*}
+  stages=${unit##*_}
+  target=generator_code_size_$unit
+
+  cmake --build "$build" --target "$target" >/dev/null
+  find "$build" -path "*/code_size/$unit.cpp" -exec touch {} +
+  start=$(date +%s.%N)
+  cmake --build "$build" --target "$target" >/dev/null
+  end=$(date +%s.%N)
+
+  object=$(find "$build" -path "*/$target.dir/*" -name "$unit.cpp.o*" | head -n 1)
+  object_bytes=$(wc -c <"$object")
+  text_bytes=$(size -A "$object" | awk '$1 ~ /^\.text/ { s += $2 } END { print s + 0 }')
+  own_bytes=$(nm -S -t d -C --defined-only "$object" |
+    awk -v ns="pipeline_$unit::" 'index($0, ns) && $3 ~ /^[tTwW]$/ { s += $2 }
+                                  END { print s + 0 }')
+
+  echo "$start $end" | awk -v kind="$kind" -v stages="$stages" -v object="$object_bytes" \
+    -v text="$text_bytes" -v own="$own_bytes" \
+    '{ printf "%-8s %6d %9.2f %10d %10d %10d %12.1f\n", kind, stages, $2 - $1, object,
+       text, own, own / stages }'
+done
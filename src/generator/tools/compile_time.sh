@@ -0,0 +1,31 @@
+#!/bin/sh
+# Compares the time taken to compile the same translation units when they #include
+# generator.h and when they import the toby.generator module.
+#
+# Usage: tools/compile_time.sh BUILD_DIR
+#
+# BUILD_DIR must have been configured with -DGENERATOR_MODULE=ON. Set
+# CMAKE_BUILD_PARALLEL_LEVEL to control the number of compiler processes.
+
+set -e
+
+build=${1:?usage: compile_time.sh BUILD_DIR}
+units=$(find "$build" -path '*/compile_time/header_*.cpp' | wc -l)
+if [ "$units" -eq 0 ]; then
+  echo "no generated translation units in $build: configure with -DGENERATOR_MODULE=ON" >&2
+  exit 1
+fi
+
+# Build everything once so that neither timing includes the library, the module's
+# interface or a stale dependency scan.
+cmake --build "$build" --target generator_compile_time_header generator_compile_time_module
+
+for variant in header module; do
+  find "$build" -path "*/compile_time/${variant}_*.cpp" -exec touch {} +
+  start=$(date +%s.%N)
+  cmake --build "$build" --target generator_compile_time_$variant >/dev/null
+  end=$(date +%s.%N)
+  echo "$start $end" | awk -v variant="$variant" -v units="$units" \
+    '{ printf "%-7s %5d units  %8.2f s  %7.1f ms/unit\n", variant, units, $2 - $1,
+       1000 * ($2 - $1) / units }'
+done